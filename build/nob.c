@@ -6,80 +6,211 @@
 
 #include "nob.h"
 
+#include <stdint.h>
+#include <sys/stat.h>
+
 #define BUILD_FOLDER "build/"
+#define DEBUG_FOLDER BUILD_FOLDER "debug/"
+#define RELEASE_FOLDER BUILD_FOLDER "release/"
 #define SRC_FOLDER "src/"
+#define SQLITE_SRC SRC_FOLDER "deps/sqlite3.c"
+#define PGO_FOLDER BUILD_FOLDER "pgo/"
+#define BENCH_FOLDER BUILD_FOLDER "bench/"
 #define BUILD_FAILED_MSG                                                                           \
     nob_log(NOB_ERROR, "--- Build failed ---------------------------------------");
 
-int main(int argc, char **argv)
-{
-    NOB_GO_REBUILD_URSELF(argc, argv);
+#if defined(_MSC_VER)
+#define OBJ_EXT ".obj"
+#else
+#define OBJ_EXT ".o"
+#endif // end _MSC_VER
 
-    nob_log(NOB_INFO, "--- Starting build -------------------------------------");
+#if defined(_WIN32)
+#define NULL_DEVICE "NUL"
+#define RMBRL_EXE_NAME "rmbrl.exe"
+#else
+#define NULL_DEVICE "/dev/null"
+#define RMBRL_EXE_NAME "rmbrl"
+#endif // end _WIN32
 
-    bool install_rmbrl = false;
-    Nob_Cmd cmd = {0};
+typedef enum
+{
+    PGO_NONE = 0,
+    PGO_GENERATE, // instrumented build that records a profile while running the training workload
+    PGO_USE,      // optimized build that uses the recorded profile
+} Pgo_Stage;
 
-    while (argc > 1)
-    {
-        char *flag = argv[1];
-        if (strcmp(flag, "--install") == 0 || strcmp(flag, "-i") == 0)
-        {
-            install_rmbrl = true;
-        }
-        else
-        {
-            nob_log(NOB_WARNING, "Unknown flag: \"%s\"", flag);
-        }
-        nob_shift_args(&argc, &argv);
-    }
+// Features remembrall needs from SQLite, used by every build profile
+static const char *sqlite_defines[] = {
+    "SQLITE_ENABLE_FTS5",
+    "SQLITE_ENABLE_MEMSYS5",   // rmbrl_sqlite_configure gives SQLite a fixed heap
+    "SQLITE_MAX_ATTACHED=125", // peek --global attaches every repository store at once
+};
 
+// remembrall is a single threaded CLI that only uses a small part of SQLite, these are the
+// recommended options from https://sqlite.org/compile.html that are safe for how we use it.
+static const char *sqlite_release_defines[] = {
+    "SQLITE_DQS=0",
+    "SQLITE_THREADSAFE=0",
+    "SQLITE_DEFAULT_MEMSTATUS=0",
+    "SQLITE_DEFAULT_WAL_SYNCHRONOUS=1",
+    "SQLITE_LIKE_DOESNT_MATCH_BLOBS",
+    "SQLITE_MAX_EXPR_DEPTH=0",
+    "SQLITE_OMIT_DECLTYPE",
+    "SQLITE_OMIT_DEPRECATED",
+    "SQLITE_OMIT_JSON",
+    "SQLITE_OMIT_LOAD_EXTENSION",
+    "SQLITE_OMIT_SHARED_CACHE",
+    "SQLITE_STRICT_SUBTYPE=1",
+    "SQLITE_USE_ALLOCA",
+};
+
+static void append_release_flags(Nob_Cmd *cmd, Pgo_Stage pgo)
+{
 #if defined(_MSC_VER)
-    int res = nob_file_exists(BUILD_FOLDER "sqlite3.obj");
+    nob_cmd_append(cmd, "/O2", "/GL");
+    NOB_UNUSED(pgo);
+#else
+    nob_cmd_append(cmd, "-O2", "-ffunction-sections", "-fdata-sections");
+#if defined(__clang__)
+    nob_cmd_append(cmd, "-flto");
 #else
-    int res = nob_file_exists(BUILD_FOLDER "sqlite3.o");
+    nob_cmd_append(cmd, "-flto=auto"); // run the link time code generation on every core
+#endif // end __clang__
+    if (pgo == PGO_GENERATE)
+        nob_cmd_append(cmd, "-fprofile-generate=" PGO_FOLDER "profile");
+#if defined(__clang__)
+    if (pgo == PGO_USE)
+        nob_cmd_append(cmd, "-fprofile-use=" PGO_FOLDER "profile/default.profdata");
+#else
+    if (pgo == PGO_USE)
+        nob_cmd_append(cmd, "-fprofile-use=" PGO_FOLDER "profile", "-fprofile-partial-training",
+                       "-Wno-missing-profile");
+#endif // end __clang__
 #endif // end _MSC_VER
+}
+
+// Appends the command that compiles one translation unit, the output path is appended by the caller
+static void append_compile_flags(Nob_Cmd *cmd, const char *src_path, bool release, Pgo_Stage pgo)
+{
+    bool is_sqlite = strcmp(src_path, SQLITE_SRC) == 0;
 
-    if (res == 0) // build/sqlite3 object file does not exist, build it
-    {
 #if defined(_MSC_VER)
-        nob_cmd_append(&cmd, "cl", "/c", "src/deps/sqlite3.c", "/Fo:build/sqlite3.obj");
+    nob_cmd_append(cmd, "cl", "/nologo", "/c", src_path);
+    if (!is_sqlite)
+        nob_cmd_append(cmd, "/W4", "/I", "src/deps");
+    for (size_t i = 0; is_sqlite && i < NOB_ARRAY_LEN(sqlite_defines); ++i)
+        nob_cmd_append(cmd, nob_temp_sprintf("/D%s", sqlite_defines[i]));
+    if (release)
+        append_release_flags(cmd, pgo);
+    for (size_t i = 0; is_sqlite && release && i < NOB_ARRAY_LEN(sqlite_release_defines); ++i)
+        nob_cmd_append(cmd, nob_temp_sprintf("/D%s", sqlite_release_defines[i]));
 #else
-        nob_cmd_append(&cmd, "cc", "-c", "src/deps/sqlite3.c", "-o", "build/sqlite3.o");
+    nob_cmd_append(cmd, "cc", "-c", src_path);
+    if (!is_sqlite)
+        nob_cmd_append(cmd, "-Wall", "-Wextra", "-Isrc/deps");
+    for (size_t i = 0; is_sqlite && i < NOB_ARRAY_LEN(sqlite_defines); ++i)
+        nob_cmd_append(cmd, nob_temp_sprintf("-D%s", sqlite_defines[i]));
+    if (release)
+        append_release_flags(cmd, pgo);
+    for (size_t i = 0; is_sqlite && release && i < NOB_ARRAY_LEN(sqlite_release_defines); ++i)
+        nob_cmd_append(cmd, nob_temp_sprintf("-D%s", sqlite_release_defines[i]));
 #endif // end _MSC_VER
+}
 
-        if (!nob_cmd_run_sync_and_reset(&cmd))
-        {
-            BUILD_FAILED_MSG
-            return 1;
-        }
-    }
-    else if (res == -1) // error is already logged, can just early exit as we depend on sqlite3.
+static const char *output_folder(bool release, Pgo_Stage pgo)
+{
+    if (pgo == PGO_GENERATE)
+        return PGO_FOLDER;
+    return release ? RELEASE_FOLDER : DEBUG_FOLDER;
+}
+
+static const char *exe_path(bool release, Pgo_Stage pgo)
+{
+    if (pgo == PGO_GENERATE)
+        return PGO_FOLDER RMBRL_EXE_NAME;
+    return release ? RELEASE_FOLDER RMBRL_EXE_NAME : DEBUG_FOLDER RMBRL_EXE_NAME;
+}
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+static bool hash_mtime(uint64_t *hash, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
     {
-        BUILD_FAILED_MSG
-        return 1;
+        nob_log(NOB_ERROR, "Could not stat %s: %s", path, strerror(errno));
+        return false;
     }
-    else
-    {
+    int64_t mtime = (int64_t)st.st_mtime;
+    *hash = fnv1a(*hash, &mtime, sizeof(mtime));
+    return true;
+}
+
+// Hashes what the compiler reports about itself, so upgrading or switching it does not reuse
+// objects built by the old one. Falls back to only the compiler name when it cannot be asked.
+static uint64_t hash_compiler(void)
+{
+    const char *version_path = BUILD_FOLDER "compiler.txt";
+    Nob_Cmd cmd = {0};
 #if defined(_MSC_VER)
-        nob_log(NOB_INFO, "Found build/sqlite3.obj");
+    const char *compiler = "cl"; // prints its version banner when run without arguments
+    nob_cmd_append(&cmd, compiler);
 #else
-        nob_log(NOB_INFO, "Found build/sqlite3.o");
+    const char *compiler = "cc";
+    nob_cmd_append(&cmd, compiler, "--version");
 #endif // end _MSC_VER
+    uint64_t hash = fnv1a(0xcbf29ce484222325ULL, compiler, strlen(compiler));
+
+    Nob_Fd fdout = nob_fd_open_for_write(version_path);
+    if (fdout == NOB_INVALID_FD)
+        return hash;
+    Nob_Fd fderr = nob_fd_open_for_write(NULL_DEVICE);
+    if (fderr == NOB_INVALID_FD)
+    {
+        nob_fd_close(fdout);
+        return hash;
     }
+    Nob_Log_Level log_level = nob_minimal_log_level;
+    nob_minimal_log_level = NOB_WARNING;
+    nob_cmd_run_sync_redirect_and_reset(&cmd, (Nob_Cmd_Redirect){.fdout = &fdout, .fderr = &fderr});
+    nob_minimal_log_level = log_level;
+    nob_cmd_free(cmd);
 
-#if defined(_MSC_VER)
-    nob_cmd_append(&cmd, "cl", "/W4", "/I", "src/deps", "build/sqlite3.obj");
-#else
-    nob_cmd_append(&cmd, "cc", "-Wall", "-Wextra", "-Isrc/deps", "build/sqlite3.o");
-#endif // end _MSC_VER
+    Nob_String_Builder version = {0};
+    if (nob_read_entire_file(version_path, &version))
+        hash = fnv1a(hash, version.items, version.count);
+    nob_sb_free(version);
+    return hash;
+}
+
+typedef struct
+{
+    const char *src_path;
+    const char *obj_path;
+    const char *tmp_path;
+} Unit;
+
+typedef struct
+{
+    Unit *items;
+    size_t count;
+    size_t capacity;
+} Units;
+
+static bool collect_units(Units *units)
+{
+    nob_da_append(units, ((Unit){.src_path = SQLITE_SRC}));
 
     Nob_File_Paths src_files = {0};
     if (!nob_read_entire_dir(SRC_FOLDER, &src_files))
-    {
-        BUILD_FAILED_MSG
-        return 1;
-    }
+        return false;
 
     for (size_t i = 0; i < src_files.count; ++i)
     {
@@ -93,25 +224,671 @@ int main(int argc, char **argv)
         if (nob_get_file_type(temp_full_path) == NOB_FILE_DIRECTORY)
             continue;
 
-        int len = strlen(temp_file_name);
-        const char *file_ext = &temp_file_name[len - 2];
-        if (strcmp(file_ext, ".h") == 0)
+        if (!nob_sv_end_with(nob_sv_from_cstr(temp_file_name), ".c"))
+            continue;
+        nob_da_append(units, ((Unit){.src_path = temp_full_path}));
+    }
+    nob_da_free(src_files);
+    return true;
+}
+
+// Headers are included by every unit of ours, a change to any of them rebuilds all of ours.
+static bool hash_headers(uint64_t *hash)
+{
+    const char *folders[] = {SRC_FOLDER, SRC_FOLDER "deps/"};
+    for (size_t i = 0; i < NOB_ARRAY_LEN(folders); ++i)
+    {
+        Nob_File_Paths files = {0};
+        if (!nob_read_entire_dir(folders[i], &files))
+            return false;
+        bool ok = true;
+        for (size_t j = 0; ok && j < files.count; ++j)
+            if (nob_sv_end_with(nob_sv_from_cstr(files.items[j]), ".h"))
+                ok = hash_mtime(hash, nob_temp_sprintf("%s%s", folders[i], files.items[j]));
+        nob_da_free(files);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+// Object files are named after a hash of the compiler, the full compile command and the source
+// mtime, so changing a flag or a define builds a new object next to the old one instead of
+// silently reusing it. PGO stages always rebuild into fixed paths, GCC finds a unit's profile by
+// its object path and that has to be the same for both stages.
+static bool unit_paths(Nob_Cmd *cmd, Unit *unit, uint64_t compiler_hash, bool release,
+                       Pgo_Stage pgo)
+{
+    const char *folder = pgo == PGO_NONE ? output_folder(release, pgo) : PGO_FOLDER;
+    const char *file_name = strrchr(unit->src_path, '/') + 1;
+    Nob_String_View stem = nob_sv_from_parts(file_name, strlen(file_name) - 2);
+
+    if (pgo != PGO_NONE)
+    {
+        unit->obj_path = nob_temp_sprintf("%s" SV_Fmt OBJ_EXT, folder, SV_Arg(stem));
+    }
+    else
+    {
+        uint64_t hash = compiler_hash;
+        append_compile_flags(cmd, unit->src_path, release, pgo);
+        for (size_t i = 0; i < cmd->count; ++i)
+            hash = fnv1a(hash, cmd->items[i], strlen(cmd->items[i]) + 1);
+        cmd->count = 0;
+        if (!hash_mtime(&hash, unit->src_path))
+            return false;
+        if (strcmp(unit->src_path, SQLITE_SRC) != 0 && !hash_headers(&hash))
+            return false;
+        unit->obj_path = nob_temp_sprintf("%s" SV_Fmt "-%016llx" OBJ_EXT, folder, SV_Arg(stem),
+                                          (unsigned long long)hash);
+    }
+    unit->tmp_path = nob_temp_sprintf("%s.tmp", unit->obj_path);
+    return true;
+}
+
+// Compiles every unit without a cached object concurrently, each into a temporary file that is
+// renamed once all of them succeeded, so an interrupted build never leaves a valid looking object.
+static bool build_objects(Nob_Cmd *cmd, Units units, bool release, Pgo_Stage pgo)
+{
+    Nob_Procs procs = {0};
+    size_t compiled = 0;
+    for (size_t i = 0; i < units.count; ++i)
+    {
+        Unit *unit = &units.items[i];
+        if (pgo == PGO_NONE && nob_file_exists(unit->obj_path) == 1)
+        {
+            nob_log(NOB_INFO, "Found %s", unit->obj_path);
+            unit->tmp_path = NULL;
+            continue;
+        }
+
+        append_compile_flags(cmd, unit->src_path, release, pgo);
+#if defined(_MSC_VER)
+        nob_cmd_append(cmd, nob_temp_sprintf("/Fo:%s", unit->tmp_path));
+#else
+        nob_cmd_append(cmd, "-o", unit->tmp_path);
+#endif // end _MSC_VER
+        nob_da_append(&procs, nob_cmd_run_async_and_reset(cmd));
+        compiled++;
+    }
+
+    bool ok = nob_procs_wait(procs);
+    nob_da_free(procs);
+    for (size_t i = 0; ok && i < units.count; ++i)
+        if (units.items[i].tmp_path != NULL)
+            ok = nob_rename(units.items[i].tmp_path, units.items[i].obj_path);
+    if (ok && compiled > 0)
+        nob_log(NOB_INFO, "Compiled %zu of %zu units", compiled, units.count);
+    return ok;
+}
+
+// Deletes the objects a unit left behind in folder under an older hash, once the build using the
+// current ones succeeded. Only names of the form <stem>-<16 hex digits> are touched.
+static bool delete_stale_objects(Units units, const char *folder)
+{
+    Nob_File_Paths files = {0};
+    if (!nob_read_entire_dir(folder, &files))
+        return false;
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < files.count; ++i)
+    {
+        Nob_String_View name = nob_sv_from_cstr(files.items[i]);
+        if (!nob_sv_end_with(name, OBJ_EXT))
             continue;
-        nob_cmd_append(&cmd, temp_full_path);
+        for (size_t j = 0; j < units.count; ++j)
+        {
+            const char *current = strrchr(units.items[j].obj_path, '/') + 1;
+            size_t stem_size = strlen(current) - strlen("-0123456789abcdef" OBJ_EXT);
+            if (name.count != strlen(current) || strncmp(name.data, current, stem_size + 1) != 0 ||
+                strcmp(name.data, current) == 0)
+                continue;
+            const char *path = nob_temp_sprintf("%s%s", folder, name.data);
+            nob_log(NOB_INFO, "Deleting stale %s", path);
+            ok = nob_delete_file(path);
+            break;
+        }
     }
+    nob_da_free(files);
+    return ok;
+}
+
+static bool link_rmbrl(Nob_Cmd *cmd, Units units, bool release, Pgo_Stage pgo)
+{
+#if defined(_MSC_VER)
+    nob_cmd_append(cmd, "cl", "/nologo");
+#else
+    nob_cmd_append(cmd, "cc");
+#endif // end _MSC_VER
+    for (size_t i = 0; i < units.count; ++i)
+        nob_cmd_append(cmd, units.items[i].obj_path);
+
+    if (release)
+        append_release_flags(cmd, pgo);
 
 #if defined(_MSC_VER)
-    nob_cmd_append(&cmd, "/Fe:" BUILD_FOLDER "rmbrl.exe", "/Fo:" BUILD_FOLDER "rmbrl.obj");
+    nob_cmd_append(cmd, nob_temp_sprintf("/Fe:%s", exe_path(release, pgo)));
+    if (release)
+        nob_cmd_append(cmd, "/link", "/LTCG", "/OPT:REF", "/OPT:ICF");
 #else
-    nob_cmd_append(&cmd, "-o", BUILD_FOLDER "rmbrl");
+    nob_cmd_append(cmd, "-o", exe_path(release, pgo));
+    nob_cmd_append(cmd, "-lm"); // FTS5's bm25 ranking uses log()
+    if (release)
+    {
+#if defined(__APPLE__)
+        nob_cmd_append(cmd, "-Wl,-dead_strip");
+#else
+        nob_cmd_append(cmd, "-Wl,--gc-sections", "-s");
+#endif // end __APPLE__
+    }
 #endif // _MSC_VER
 
-    if (!nob_cmd_run_sync_and_reset(&cmd))
+    return nob_cmd_run_sync_and_reset(cmd);
+}
+
+// Builds rmbrl into exe_path(release, pgo)
+static bool build_rmbrl(Nob_Cmd *cmd, uint64_t compiler_hash, bool release, Pgo_Stage pgo)
+{
+    if (!nob_mkdir_if_not_exists(output_folder(release, pgo)))
+        return false;
+
+    Units units = {0};
+    bool ok = collect_units(&units);
+    for (size_t i = 0; ok && i < units.count; ++i)
+        ok = unit_paths(cmd, &units.items[i], compiler_hash, release, pgo);
+    ok = ok && build_objects(cmd, units, release, pgo) &&
+         link_rmbrl(cmd, units, release, pgo);
+    if (ok && pgo == PGO_NONE)
+        ok = delete_stale_objects(units, output_folder(release, pgo));
+    nob_da_free(units);
+    return ok;
+}
+
+static void set_env(const char *name, const char *value)
+{
+#if defined(_WIN32)
+    _putenv_s(name, value);
+#else
+    setenv(name, value, 1);
+#endif // end _WIN32
+}
+
+// Runs cmd with stdout and stderr discarded, stdin is read from stdin_path when not NULL.
+static bool run_quiet(Nob_Cmd *cmd, const char *stdin_path)
+{
+    Nob_Fd fdin = NOB_INVALID_FD;
+    if (stdin_path != NULL)
+    {
+        fdin = nob_fd_open_for_read(stdin_path);
+        if (fdin == NOB_INVALID_FD)
+            return false;
+    }
+    Nob_Fd fdout = nob_fd_open_for_write(NULL_DEVICE);
+    Nob_Fd fderr = nob_fd_open_for_write(NULL_DEVICE);
+    if (fdout == NOB_INVALID_FD || fderr == NOB_INVALID_FD)
+        return false;
+
+    return nob_cmd_run_sync_redirect_and_reset(cmd, (Nob_Cmd_Redirect){
+                                                        .fdin = stdin_path ? &fdin : NULL,
+                                                        .fdout = &fdout,
+                                                        .fderr = &fderr,
+                                                    });
+}
+
+// Scripted add/peek/clear workload for the instrumented binary, covers the hot paths that our
+// users actually run: single adds, bulk adds, peeks in every format and clears.
+static bool run_pgo_training(Nob_Cmd *cmd)
+{
+    // profiles from an earlier run would be merged into this one, start from a clean slate
+    Nob_File_Paths profiles = {0};
+    if (!nob_read_entire_dir(PGO_FOLDER "profile", &profiles))
+        return false;
+    for (size_t i = 0; i < profiles.count; ++i)
+    {
+        const char *path = nob_temp_sprintf(PGO_FOLDER "profile/%s", profiles.items[i]);
+        if (nob_get_file_type(path) == NOB_FILE_REGULAR && !nob_delete_file(path))
+            return false;
+    }
+    profiles.count = 0;
+
+    // point remembrall at a throw away store instead of the real one
+    const char *db_path = PGO_FOLDER "training.db";
+    const char *store_files[] = {db_path, PGO_FOLDER "training.db-wal",
+                                 PGO_FOLDER "training.db-shm"};
+    for (size_t i = 0; i < NOB_ARRAY_LEN(store_files); ++i)
+        if (nob_file_exists(store_files[i]) == 1 && !nob_delete_file(store_files[i]))
+            return false;
+    set_env("RMBRL_DB", db_path);
+
+    const char *rmbrl = exe_path(true, PGO_GENERATE);
+
+    const char *tasks_path = PGO_FOLDER "tasks.txt";
+    Nob_String_Builder tasks = {0};
+    for (int i = 0; i < 5000; ++i)
+        nob_sb_append_cstr(&tasks, nob_temp_sprintf("training task number %d\n", i));
+    bool ok = nob_write_entire_file(tasks_path, tasks.items, tasks.count);
+    nob_sb_free(tasks);
+    if (!ok)
+        return false;
+
+    nob_log(NOB_INFO, "Running PGO training workload...");
+    const char *projects[] = {"alpha", "beta", "gamma", "delta"};
+    for (size_t i = 0; i < NOB_ARRAY_LEN(projects); ++i)
+    {
+        nob_cmd_append(cmd, rmbrl, "add", "--stdin", "-p", projects[i]);
+        if (!run_quiet(cmd, tasks_path))
+            return false;
+    }
+
+    for (int i = 0; i < 50; ++i)
+    {
+        const char *project = projects[i % NOB_ARRAY_LEN(projects)];
+        const char *task = nob_temp_sprintf("training add %d", i);
+
+        nob_cmd_append(cmd, rmbrl, "add", task);
+        ok = ok && run_quiet(cmd, NULL);
+        nob_cmd_append(cmd, rmbrl, "add", "--project", project, task);
+        ok = ok && run_quiet(cmd, NULL);
+        nob_cmd_append(cmd, rmbrl, "peek");
+        ok = ok && run_quiet(cmd, NULL);
+        nob_cmd_append(cmd, rmbrl, "peek", "-s", "-p", project);
+        ok = ok && run_quiet(cmd, NULL);
+        nob_cmd_append(cmd, rmbrl, "peek", "--limit", "20", "--after", "100", "--format=tsv");
+        ok = ok && run_quiet(cmd, NULL);
+        nob_cmd_append(cmd, rmbrl, "clear", "-p", project);
+        ok = ok && run_quiet(cmd, NULL);
+        nob_cmd_append(cmd, rmbrl, "clear");
+        ok = ok && run_quiet(cmd, NULL);
+        if (!ok)
+            return false;
+        nob_temp_reset();
+    }
+
+    const char *formats[] = {"--format=text", "--format=json", "--format=ndjson", "-v"};
+    for (size_t i = 0; i < NOB_ARRAY_LEN(formats); ++i)
+    {
+        nob_cmd_append(cmd, rmbrl, "peek", "--all", formats[i]);
+        if (!run_quiet(cmd, NULL))
+            return false;
+    }
+
+    nob_cmd_append(cmd, rmbrl, "clear", "--all", "-p", projects[0]);
+    if (!run_quiet(cmd, NULL))
+        return false;
+    nob_cmd_append(cmd, rmbrl, "clear", "--all");
+    if (!run_quiet(cmd, NULL))
+        return false;
+
+#if defined(__clang__)
+    // clang writes raw profiles that have to be merged before they can be used
+    if (!nob_read_entire_dir(PGO_FOLDER "profile", &profiles))
+        return false;
+    nob_cmd_append(cmd, "llvm-profdata", "merge", "-output=" PGO_FOLDER "profile/default.profdata");
+    for (size_t i = 0; i < profiles.count; ++i)
+        if (nob_sv_end_with(nob_sv_from_cstr(profiles.items[i]), ".profraw"))
+            nob_cmd_append(cmd, nob_temp_sprintf(PGO_FOLDER "profile/%s", profiles.items[i]));
+    if (!nob_cmd_run_sync_and_reset(cmd))
+        return false;
+#endif // end __clang__
+
+    nob_da_free(profiles);
+    return true;
+}
+
+// Benchmark
+//
+// Seeds synthetic stores of each size and reports p50/p99 wall time of whole rmbrl invocations,
+// process spawn included, as that is what users and scripts pay for.
+
+#if defined(_WIN32)
+static double now_ms(void)
+{
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1000.0 / (double)freq.QuadPart;
+}
+#else
+#include <time.h>
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+#endif // end _WIN32
+
+typedef struct
+{
+    double *items;
+    size_t count;
+    size_t capacity;
+} Samples;
+
+typedef struct
+{
+    size_t rows[8];
+    size_t rows_count;
+    size_t projects;
+    size_t iterations;
+    const char *dir;
+    const char *exe;
+} Bench_Config;
+
+static int compare_samples(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest rank percentile, samples must be sorted
+static double percentile(Samples samples, double p)
+{
+    size_t rank = (size_t)(p / 100.0 * (double)samples.count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > samples.count)
+        rank = samples.count;
+    return samples.items[rank - 1];
+}
+
+// Deletes the store at db_path together with the files rmbrl keeps next to it
+static bool delete_store(const char *db_path)
+{
+    const char *suffixes[] = {"", "-wal", "-shm", "-snap", "-wlog"};
+    for (size_t i = 0; i < NOB_ARRAY_LEN(suffixes); ++i)
+    {
+        const char *path = nob_temp_sprintf("%s%s", db_path, suffixes[i]);
+        if (nob_file_exists(path) == 1 && !nob_delete_file(path))
+            return false;
+    }
+    return true;
+}
+
+static bool seed_store(Nob_Cmd *cmd, const Bench_Config *config, size_t rows, const char *db_path)
+{
+    if (!delete_store(db_path))
+        return false;
+    set_env("RMBRL_DB", db_path);
+
+    const char *tasks_path = nob_temp_sprintf("%stasks.txt", config->dir);
+    size_t per_project = rows / config->projects;
+    for (size_t p = 0; p < config->projects; ++p)
+    {
+        // last project picks up the remainder so the store has exactly rows memories
+        size_t count = p + 1 == config->projects ? rows - per_project * p : per_project;
+
+        Nob_String_Builder tasks = {0};
+        for (size_t i = 0; i < count; ++i)
+        {
+            char task[64];
+            int len = snprintf(task, sizeof(task), "bench task %zu of project %zu\n", i, p);
+            nob_sb_append_buf(&tasks, task, (size_t)len);
+        }
+        bool ok = nob_write_entire_file(tasks_path, tasks.items, tasks.count);
+        nob_sb_free(tasks);
+        if (!ok)
+            return false;
+
+        const char *project = nob_temp_sprintf("project-%zu", p);
+        nob_cmd_append(cmd, config->exe, "add", "--stdin", "-p", project);
+        if (!run_quiet(cmd, tasks_path))
+            return false;
+    }
+    return true;
+}
+
+// Stores are in WAL mode, the -wal file holds recent commits and a stale one must never be
+// replayed onto a different copy of the database.
+static bool copy_store(const char *src_path, const char *dst_path)
+{
+    const char *suffixes[] = {"-wal", "-shm"};
+    for (size_t i = 0; i < NOB_ARRAY_LEN(suffixes); ++i)
+    {
+        const char *path = nob_temp_sprintf("%s%s", dst_path, suffixes[i]);
+        if (nob_file_exists(path) == 1 && !nob_delete_file(path))
+            return false;
+    }
+
+    if (!nob_copy_file(src_path, dst_path))
+        return false;
+
+    const char *src_wal = nob_temp_sprintf("%s-wal", src_path);
+    if (nob_file_exists(src_wal) == 1)
+        return nob_copy_file(src_wal, nob_temp_sprintf("%s-wal", dst_path));
+    return true;
+}
+
+// Times iterations runs of the given rmbrl arguments against a working copy of the seeded store.
+// When fresh_copy is true the store is restored before every run, for destructive commands.
+static bool bench_command(Nob_Cmd *cmd, const Bench_Config *config, size_t rows,
+                          const char *seed_path, const char **args, size_t args_count,
+                          bool fresh_copy)
+{
+    const char *work_path = nob_temp_sprintf("%swork.db", config->dir);
+    set_env("RMBRL_DB", work_path);
+
+    Samples samples = {0};
+    bool ok = true;
+    for (size_t i = 0; ok && i < config->iterations; ++i)
+    {
+        if ((i == 0 || fresh_copy) && !copy_store(seed_path, work_path))
+        {
+            ok = false;
+            break;
+        }
+
+        nob_cmd_append(cmd, config->exe);
+        nob_da_append_many(cmd, args, args_count);
+
+        double start = now_ms();
+        ok = run_quiet(cmd, NULL);
+        nob_da_append(&samples, now_ms() - start);
+    }
+
+    if (ok)
+    {
+        Nob_String_Builder name = {0};
+        for (size_t i = 0; i < args_count; ++i)
+        {
+            if (i > 0)
+                nob_sb_append_cstr(&name, " ");
+            nob_sb_append_cstr(&name, args[i]);
+        }
+        nob_sb_append_null(&name);
+
+        qsort(samples.items, samples.count, sizeof(*samples.items), compare_samples);
+        printf("%10zu  %-28s %6zu %10.3f %10.3f\n", rows, name.items, samples.count,
+               percentile(samples, 50), percentile(samples, 99));
+        fflush(stdout);
+        nob_sb_free(name);
+    }
+
+    nob_da_free(samples);
+    return ok;
+}
+
+static bool run_bench(Nob_Cmd *cmd, const Bench_Config *config)
+{
+    if (!nob_mkdir_if_not_exists(config->dir))
+        return false;
+
+    nob_log(NOB_INFO, "--- Benchmark: %zu projects, %zu iterations, in %s", config->projects,
+            config->iterations, config->dir);
+    printf("%10s  %-28s %6s %10s %10s\n", "rows", "command", "runs", "p50 (ms)", "p99 (ms)");
+    fflush(stdout);
+
+    // every spawned command and copied store would be logged otherwise, inside of the timings
+    Nob_Log_Level log_level = nob_minimal_log_level;
+
+    const char *add[] = {"add", "bench add", "-p", "project-0"};
+    const char *peek[] = {"peek"};
+    const char *peek_all[] = {"peek", "--all"};
+    const char *search[] = {"search", "task 42", "--limit", "10"};
+    const char *clear[] = {"clear"};
+    const char *clear_all[] = {"clear", "--all"};
+
+    for (size_t i = 0; i < config->rows_count; ++i)
+    {
+        size_t rows = config->rows[i];
+        const char *seed_path = nob_temp_sprintf("%sseed-%zu.db", config->dir, rows);
+        nob_log(NOB_INFO, "Seeding %zu memories...", rows);
+        nob_minimal_log_level = NOB_WARNING;
+        bool ok =
+            seed_store(cmd, config, rows, seed_path) &&
+            bench_command(cmd, config, rows, seed_path, add, NOB_ARRAY_LEN(add), false) &&
+            bench_command(cmd, config, rows, seed_path, peek, NOB_ARRAY_LEN(peek), false) &&
+            bench_command(cmd, config, rows, seed_path, peek_all, NOB_ARRAY_LEN(peek_all), false) &&
+            bench_command(cmd, config, rows, seed_path, search, NOB_ARRAY_LEN(search), false) &&
+            bench_command(cmd, config, rows, seed_path, clear, NOB_ARRAY_LEN(clear), false) &&
+            bench_command(cmd, config, rows, seed_path, clear_all, NOB_ARRAY_LEN(clear_all), true);
+
+        // a seeded store of 1M memories is over 150 MB, none of them outlives its row count
+        const char *tasks_path = nob_temp_sprintf("%stasks.txt", config->dir);
+        ok = delete_store(seed_path) && delete_store(nob_temp_sprintf("%swork.db", config->dir)) &&
+             (nob_file_exists(tasks_path) != 1 || nob_delete_file(tasks_path)) && ok;
+        nob_minimal_log_level = log_level;
+        if (!ok)
+            return false;
+        nob_temp_reset();
+    }
+
+    return true;
+}
+
+static bool parse_bench_rows(const char *value, Bench_Config *config)
+{
+    config->rows_count = 0;
+    while (*value != '\0')
+    {
+        char *end;
+        unsigned long long rows = strtoull(value, &end, 10);
+        if (end == value || rows == 0 || config->rows_count == NOB_ARRAY_LEN(config->rows))
+            return false;
+        config->rows[config->rows_count++] = (size_t)rows;
+        value = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0')
+            return false;
+    }
+    return config->rows_count > 0;
+}
+
+int main(int argc, char **argv)
+{
+    NOB_GO_REBUILD_URSELF(argc, argv);
+
+    nob_log(NOB_INFO, "--- Starting build -------------------------------------");
+
+    bool install_rmbrl = false;
+    bool release = false;
+    bool pgo = false;
+    bool bench = false;
+    Bench_Config bench_config = {
+        .rows = {1000, 100000, 1000000},
+        .rows_count = 3,
+        .projects = 10,
+        .iterations = 20,
+        .dir = BENCH_FOLDER,
+    };
+    Nob_Cmd cmd = {0};
+
+    while (argc > 1)
+    {
+        char *flag = argv[1];
+        if (strcmp(flag, "--install") == 0 || strcmp(flag, "-i") == 0)
+        {
+            install_rmbrl = true;
+        }
+        else if (strcmp(flag, "--release") == 0 || strcmp(flag, "-r") == 0)
+        {
+            release = true;
+        }
+        else if (strcmp(flag, "--pgo") == 0)
+        {
+            release = true;
+            pgo = true;
+        }
+        else if (strcmp(flag, "bench") == 0)
+        {
+            bench = true;
+        }
+        else if (strncmp(flag, "--rows=", 7) == 0)
+        {
+            if (!parse_bench_rows(flag + 7, &bench_config))
+            {
+                nob_log(NOB_ERROR, "Invalid rows \"%s\", expected e.g. --rows=1000,100000", flag);
+                return 1;
+            }
+        }
+        else if (strncmp(flag, "--projects=", 11) == 0)
+        {
+            bench_config.projects = strtoul(flag + 11, NULL, 10);
+            if (bench_config.projects == 0)
+                bench_config.projects = 1;
+        }
+        else if (strncmp(flag, "--iterations=", 13) == 0)
+        {
+            bench_config.iterations = strtoul(flag + 13, NULL, 10);
+            if (bench_config.iterations == 0)
+                bench_config.iterations = 1;
+        }
+        else if (strncmp(flag, "--bench-dir=", 12) == 0)
+        {
+            // keep the trailing separator, paths are built by appending file names. Not in temp
+            // memory, run_bench resets it after every row count.
+            static char bench_dir[1024];
+            size_t len = strlen(flag + 12);
+            bool has_sep = len > 0 && (flag[12 + len - 1] == '/' || flag[12 + len - 1] == '\\');
+            if (snprintf(bench_dir, sizeof(bench_dir), has_sep ? "%s" : "%s/", flag + 12) >=
+                (int)sizeof(bench_dir))
+            {
+                nob_log(NOB_ERROR, "Bench directory \"%s\" is too long", flag + 12);
+                return 1;
+            }
+            bench_config.dir = bench_dir;
+        }
+        else
+        {
+            nob_log(NOB_WARNING, "Unknown flag: \"%s\"", flag);
+        }
+        nob_shift_args(&argc, &argv);
+    }
+
+#if defined(_MSC_VER)
+    if (pgo)
+    {
+        nob_log(NOB_WARNING, "--pgo is not supported with MSVC, building --release without it");
+        pgo = false;
+    }
+#endif // end _MSC_VER
+
+    uint64_t compiler_hash = hash_compiler();
+    if (pgo)
+    {
+        nob_log(NOB_INFO, "--- PGO: instrumented build -----------------------------");
+        if (!nob_mkdir_if_not_exists(PGO_FOLDER) ||
+            !nob_mkdir_if_not_exists(PGO_FOLDER "profile") ||
+            !build_rmbrl(&cmd, compiler_hash, release, PGO_GENERATE) || !run_pgo_training(&cmd))
+        {
+            BUILD_FAILED_MSG
+            return 1;
+        }
+        nob_log(NOB_INFO, "--- PGO: optimized build --------------------------------");
+    }
+
+    Pgo_Stage pgo_stage = pgo ? PGO_USE : PGO_NONE;
+    if (!build_rmbrl(&cmd, compiler_hash, release, pgo_stage))
     {
         BUILD_FAILED_MSG
         return 1;
     }
 
+    bench_config.exe = exe_path(release, pgo_stage);
+    if (bench && !run_bench(&cmd, &bench_config))
+    {
+        nob_log(NOB_ERROR, "--- Benchmark failed -----------------------------------");
+        return 1;
+    }
+
     if (install_rmbrl)
     {
 #if defined(_WIN32)
@@ -126,11 +903,15 @@ int main(int argc, char **argv)
         snprintf(rmbrl_path, sizeof(rmbrl_path), "%s\\rmbrl\\", appdata);
 
         char *install_path = rmbrl_path;
-        nob_cmd_append(&cmd, "cmd", "/c", "copy", "build\\rmbrl.exe", install_path);
+        // copy would read the forward slashes of our paths as switches
+        char *rmbrl_exe = nob_temp_sprintf("%s", exe_path(release, pgo_stage));
+        for (char *c = rmbrl_exe; *c != '\0'; ++c)
+            if (*c == '/')
+                *c = '\\';
+        nob_cmd_append(&cmd, "cmd", "/c", "copy", rmbrl_exe, install_path);
 #else
         char *install_path = "/usr/local/bin";
-        char *rmbrl_exe = BUILD_FOLDER "rmbrl";
-        nob_cmd_append(&cmd, "sudo", "cp", rmbrl_exe, install_path);
+        nob_cmd_append(&cmd, "sudo", "cp", exe_path(release, pgo_stage), install_path);
 
         char *home_env = getenv("HOME");
         if (home_env == NULL)
@@ -2,30 +2,226 @@
 // MIT license, see LICENSE for more
 
 #include "./deps/sqlite3.h"
+#include <ctype.h>
 #include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <direct.h>
+#include <process.h>
 #include <windows.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 #endif
 
 #define RMBRL_VERSION "v0.1.0"
 
+// Exit code of an invocation that ran out of its --timeout-ms budget
+#define RMBRL_EXIT_TIMEOUT 3
+
+#ifndef RMBRL_DEFAULT_BATCH_SIZE
+#define RMBRL_DEFAULT_BATCH_SIZE 10000
+#endif
+
+#ifndef RMBRL_DEFAULT_BUSY_TIMEOUT_MS
+#define RMBRL_DEFAULT_BUSY_TIMEOUT_MS 5000
+#endif
+
+// Days `rmbrl stats` shows without --limit or --all
+#ifndef RMBRL_STATS_DAYS
+#define RMBRL_STATS_DAYS 30
+#endif
+
+#ifndef RMBRL_BUSY_MAX_SLEEP_MS
+#define RMBRL_BUSY_MAX_SLEEP_MS 50
+#endif
+
+// WAL size after which a writing invocation checkpoints and truncates it on close, see
+// rmbrl_db_close
+#ifndef RMBRL_WAL_TRUNCATE_SIZE
+#define RMBRL_WAL_TRUNCATE_SIZE (256 * 1024)
+#endif
+
+// How long `rmbrl gc` keeps archived memories without --older-than or --all
+#ifndef RMBRL_DEFAULT_GC_RETENTION_MS
+#define RMBRL_DEFAULT_GC_RETENTION_MS (30LL * 24 * 60 * 60 * 1000)
+#endif
+
+// How far ahead `rmbrl due` looks without --window or --all
+#ifndef RMBRL_DEFAULT_DUE_WINDOW_MS
+#define RMBRL_DEFAULT_DUE_WINDOW_MS (24LL * 60 * 60 * 1000)
+#endif
+
+// Tags one memory or one filter can have, see --tag
+#ifndef RMBRL_MAX_TAGS
+#define RMBRL_MAX_TAGS 16
+#endif
+
+// Free pages `rmbrl gc` returns to the file system per incremental vacuum step
+#ifndef RMBRL_GC_VACUUM_PAGES
+#define RMBRL_GC_VACUUM_PAGES 1024
+#endif
+
+// Memory SQLite may use, see rmbrl_sqlite_configure. 0 leaves SQLite on malloc.
+#ifndef RMBRL_SQLITE_HEAP_SIZE
+#define RMBRL_SQLITE_HEAP_SIZE (16 * 1024 * 1024)
+#endif
+
+// Heap usage above which SQLite recycles its page cache before allocating more, 0 disables it
+#ifndef RMBRL_SQLITE_SOFT_HEAP_LIMIT
+#define RMBRL_SQLITE_SOFT_HEAP_LIMIT (RMBRL_SQLITE_HEAP_SIZE / 4 * 3)
+#endif
+
+// Pages held in the static page cache, the cache grows into the heap past this
+#ifndef RMBRL_SQLITE_PAGECACHE_PAGES
+#define RMBRL_SQLITE_PAGECACHE_PAGES 256
+#endif
+
+// Arena
+//
+// An invocation allocates a handful of small buffers and exits, so RMBRL_REALLOC, RMBRL_FREE and
+// RMBRL_STRDUP default to a bump allocator over a static buffer instead of malloc. Growing the
+// most recent allocation, which is what the dynamic arrays do, happens in place and freeing it
+// gives the space back. Everything else is released at once by rmbrl_arena_reset, which
+// `rmbrl serve` calls after every request. Allocations that do not fit fall back to malloc.
+
+#ifndef RMBRL_ARENA_CAP
+#define RMBRL_ARENA_CAP (256 * 1024)
+#endif
+
+typedef union
+{
+    long double ld;
+    long long ll;
+    void *ptr;
+} Rmbrl_Align;
+
+#define RMBRL_ALIGN_UP(size)                                                                       \
+    (((size) + sizeof(Rmbrl_Align) - 1) / sizeof(Rmbrl_Align) * sizeof(Rmbrl_Align))
+
+static struct
+{
+    size_t count; // bytes in use
+    size_t last;  // offset of the header of the most recent allocation
+    Rmbrl_Align buf[RMBRL_ARENA_CAP / sizeof(Rmbrl_Align)];
+} rmbrl_arena = {.last = (size_t)-1};
+
+static inline bool rmbrl_arena_owns(const void *ptr)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+    uintptr_t base = (uintptr_t)rmbrl_arena.buf;
+    return addr >= base && addr < base + sizeof(rmbrl_arena.buf);
+}
+
+// Every allocation is preceded by a header holding its size, realloc needs it to copy.
+static inline void *rmbrl_arena_alloc(size_t size)
+{
+    size_t needed = sizeof(Rmbrl_Align) + RMBRL_ALIGN_UP(size);
+    if (size > sizeof(rmbrl_arena.buf) || needed > sizeof(rmbrl_arena.buf) - rmbrl_arena.count)
+        return malloc(size);
+
+    char *header = (char *)rmbrl_arena.buf + rmbrl_arena.count;
+    *(size_t *)header = size;
+    rmbrl_arena.last = rmbrl_arena.count;
+    rmbrl_arena.count += needed;
+    return header + sizeof(Rmbrl_Align);
+}
+
+static inline void *rmbrl_arena_realloc(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        return rmbrl_arena_alloc(size);
+    if (!rmbrl_arena_owns(ptr))
+        return realloc(ptr, size);
+
+    char *header = (char *)ptr - sizeof(Rmbrl_Align);
+    size_t old_size = *(size_t *)header;
+    size_t offset = (size_t)(header - (char *)rmbrl_arena.buf);
+    if (offset == rmbrl_arena.last)
+    {
+        size_t needed = sizeof(Rmbrl_Align) + RMBRL_ALIGN_UP(size);
+        if (needed <= sizeof(rmbrl_arena.buf) - offset)
+        {
+            *(size_t *)header = size;
+            rmbrl_arena.count = offset + needed;
+            return ptr;
+        }
+        // does not fit in place, so it does not fit anywhere in the arena either
+        rmbrl_arena.count = offset;
+        rmbrl_arena.last = (size_t)-1;
+    }
+    else if (size <= old_size)
+    {
+        return ptr;
+    }
+
+    void *moved = rmbrl_arena_alloc(size);
+    if (moved != NULL)
+        memcpy(moved, ptr, old_size < size ? old_size : size);
+    return moved;
+}
+
+// Only the most recent allocation is given back, the rest waits for rmbrl_arena_reset.
+static inline void rmbrl_arena_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    if (!rmbrl_arena_owns(ptr))
+    {
+        free(ptr);
+        return;
+    }
+
+    size_t offset = (size_t)((char *)ptr - sizeof(Rmbrl_Align) - (char *)rmbrl_arena.buf);
+    if (offset == rmbrl_arena.last)
+    {
+        rmbrl_arena.count = offset;
+        rmbrl_arena.last = (size_t)-1;
+    }
+}
+
+static inline char *rmbrl_arena_strdup(const char *str)
+{
+    size_t size = strlen(str) + 1;
+    char *dup = rmbrl_arena_alloc(size);
+    if (dup != NULL)
+        memcpy(dup, str, size);
+    return dup;
+}
+
+static inline void rmbrl_arena_reset(void)
+{
+    rmbrl_arena.count = 0;
+    rmbrl_arena.last = (size_t)-1;
+}
+
 #ifndef RMBRL_REALLOC
-#include <stdlib.h>
-#define RMBRL_REALLOC realloc
+#define RMBRL_REALLOC rmbrl_arena_realloc
 #endif /* RMBRL_REALLOC */
 
 #ifndef RMBRL_FREE
-#include <stdlib.h>
-#define RMBRL_FREE free
+#define RMBRL_FREE rmbrl_arena_free
 #endif /* RMBRL_FREE */
 
 #ifndef RMBRL_ASSERT
@@ -34,8 +230,7 @@
 #endif /* RMBRL_ASSERT */
 
 #ifndef RMBRL_STRDUP
-#include <string.h>
-#define RMBRL_STRDUP strdup
+#define RMBRL_STRDUP rmbrl_arena_strdup
 #endif /* RMBRL_STRDUP */
 
 static inline char *rmbrl_strdup(const char *str)
@@ -96,22 +291,114 @@ static inline char *rmbrl_strdup(const char *str)
         (da)->items[(da)->count++] = (item);                                                       \
     } while (0)
 
+#define rmbrl_da_append_many(da, new_items, new_items_count)                                       \
+    do                                                                                             \
+    {                                                                                              \
+        rmbrl_da_reserve((da), (da)->count + (new_items_count));                                   \
+        memcpy((da)->items + (da)->count, (new_items), (new_items_count) * sizeof(*(da)->items));  \
+        (da)->count += (new_items_count);                                                          \
+    } while (0)
+
 #define rmbrl_da_free(da) RMBRL_FREE((da).items)
 
+// String Builder
+
+typedef struct
+{
+    char *items;
+    size_t capacity;
+    size_t count;
+} Rmbrl_String_Builder;
+
+#define rmbrl_sb_append_cstr(sb, cstr)                                                             \
+    do                                                                                             \
+    {                                                                                              \
+        const char *s = (cstr);                                                                    \
+        size_t n = strlen(s);                                                                      \
+        rmbrl_da_append_many(sb, s, n);                                                            \
+    } while (0)
+
+#define rmbrl_sb_append_null(sb) rmbrl_da_append_many(sb, "", 1)
+
+#define rmbrl_sb_free(sb) RMBRL_FREE((sb).items)
+
 void rmbrl_print_help()
 {
     printf("Usage: program (COMMAND) [FLAGS]\n\n");
 
     printf("Commands:\n");
-    printf("  add     Add memory to your collection (supports --project)\n");
-    printf("  peek    Show what you're currently remembering (supports --all, --project)\n");
-    printf("  clear   Forget memories (supports --all, --project)\n\n");
+    printf("  add     Add memory to your collection (supports --project, --tag, --stdin, --due)\n");
+    printf("  peek    Show what you're currently remembering (supports --all, --project, --tag,\n");
+    printf("          --limit, --after, --cached, --global, --by-due, --watch)\n");
+    printf("  due     Show overdue memories and the ones due within a window, soonest first\n");
+    printf("          (supports --window, --all, --project, --tag, --limit)\n");
+    printf("  clear   Forget memories (supports --all, --project, --limit, --older-than,\n");
+    printf("          --archive)\n");
+    printf("  search  Find memories containing every word of a query, best match first\n");
+    printf("          (supports --project, --limit)\n");
+    printf("  projects List projects with the number of memories in each (supports --project)\n");
+    printf("  gc      Purge archived memories and shrink the database (supports --older-than,\n");
+    printf("          --all)\n");
+    printf("  export  Write every memory, oldest first, as ndjson (default), csv, tsv or json\n");
+    printf("          (supports --project, --format)\n");
+    printf("  import  Add the memories of an ndjson (default) or csv export read from stdin\n");
+    printf("          (supports --project, --format, --batch-size)\n");
+    printf("  complete Print the names of projects starting with a prefix, or the bash, zsh or\n");
+    printf("          fish script completing them, e.g. source <(rmbrl complete bash)\n");
+    printf("  stats   Show how many memories there are, per project and added and cleared per\n");
+    printf("          day, and the oldest one (supports --project, --limit, --all, --format)\n");
+    printf("  compact Fold the memories added with --backend log into the store\n");
+    printf("  exec    Run one command per line of a script, or of stdin with -, in a single\n");
+    printf("          transaction that the first failing command rolls back\n");
+    printf("  init    Keep the memories of the current directory in its own .rmbrl.db, used\n");
+    printf("          from it and every directory below it\n");
+    printf("  serve   Keep the store open and run every other invocation on it until\n");
+    printf("          interrupted, e.g. for scripts calling rmbrl in a loop (not on Windows)\n");
+    printf("  backup  Copy the store to a path while it is in use (supports --compact)\n");
+    printf("  restore Replace the store with the backup at a path\n\n");
 
     printf("Command Flags:\n");
     printf("  -p, --project    Tag and filter memories by project name\n");
-    printf("                   (supported by: add, peek, clear)\n");
-    printf("  -a, --all        Apply operation to all memories\n");
-    printf("                   (supported by: peek, clear)\n\n");
+    printf("                   (supported by: add, peek, due, clear, search, projects, export),\n");
+    printf("                   import puts every memory into the given project\n");
+    printf("  -t, --tag        Tag a memory, repeat for more tags, or only show memories with\n");
+    printf("                   every given tag (supported by: add, peek, due)\n");
+    printf("      --stdin      Add one memory per line read from stdin\n");
+    printf("                   (supported by: add)\n");
+    printf("  -0, --null       Read NUL delimited tasks with --stdin, e.g. from find -print0\n");
+    printf("                   (supported by: add)\n");
+    printf("      --batch-size Commit every N memories read from stdin, defaults to %d\n",
+           RMBRL_DEFAULT_BATCH_SIZE);
+    printf("                   (supported by: add, import)\n");
+    printf("      --due        Remember when a memory is due: a duration from now such as 2d, a\n");
+    printf("                   UTC date such as 2026-10-20 or \"2026-10-20 17:00:00\"\n");
+    printf("                   (supported by: add)\n");
+    printf("  -a, --all        Apply operation to all memories, stats shows every day, due\n");
+    printf("                   every memory with a due date (supported by: peek, clear, gc,\n");
+    printf("                   stats, due)\n");
+    printf("  -l, --limit      Show or forget at most N memories, peek and clear default to 1\n");
+    printf("                   without --all, stats shows the N latest days, defaults to %d\n",
+           RMBRL_STATS_DAYS);
+    printf("                   (supported by: peek, search, clear, stats, due)\n");
+    printf("      --older-than Forget memories older than a duration, e.g. 90s, 15m, 12h, 30d\n");
+    printf("                   or 2w, gc purges memories archived longer ago than it, defaults\n");
+    printf("                   to 30d (supported by: clear, gc)\n");
+    printf("      --archive    Keep forgotten memories as history until `rmbrl gc` purges them\n");
+    printf("                   (supported by: clear)\n");
+    printf("      --after      Show memories older than the memory with the given id, or due\n");
+    printf("                   after it with --by-due (supported by: peek)\n");
+    printf("      --by-due     Show memories with a due date, soonest first, e.g. the next\n");
+    printf("                   deadline for a prompt (supported by: peek)\n");
+    printf("      --window     Show memories due within a duration from now, defaults to 1d\n");
+    printf("                   (supported by: due)\n");
+    printf("      --watch      Keep running and print the memories again whenever they change,\n");
+    printf("                   e.g. for status bars (supported by: peek)\n");
+    printf("      --compact    Write the backup with VACUUM INTO, without free pages\n");
+    printf("                   (supported by: backup)\n");
+    printf("      --cached     Serve the latest memory from a snapshot without opening the\n");
+    printf("                   database, e.g. for shell prompts (supported by: peek)\n");
+    printf("      --global     Show memories of the global store and of every repository store\n");
+    printf("                   created by `rmbrl init` together (supported by: peek)\n\n");
 
     printf("Global Flags:\n");
     printf("  -h, --help       Show help information\n");
@@ -119,6 +406,133 @@ void rmbrl_print_help()
     printf("  -v, --verbose    Enable verbose output\n");
     printf("  -s, --silent     Enable silent mode\n");
     printf("  -n, --dry-run    Perform dry run without making changes\n");
+    printf("      --stats      Report phase timings and SQLite counters as one JSON line on\n");
+    printf("                   stderr\n");
+    printf("      --db         Use the database at the given path, e.g. \":memory:\"\n");
+    printf("                   (defaults to $RMBRL_DB, then the nearest .rmbrl.db, then the OS\n");
+    printf("                   application data directory)\n");
+    printf("      --busy-timeout\n");
+    printf("                   Milliseconds to wait for a locked database, defaults to\n");
+    printf("                   $RMBRL_BUSY_TIMEOUT or %d\n", RMBRL_DEFAULT_BUSY_TIMEOUT_MS);
+    printf("      --timeout-ms Give up once the invocation ran for this many milliseconds and\n");
+    printf("                   exit with %d, defaults to $RMBRL_TIMEOUT_MS or no limit\n",
+           RMBRL_EXIT_TIMEOUT);
+    printf("      --backend    How add stores memories: sqlite (default) commits each one, log\n");
+    printf("                   appends it to a write log folded into the store later, defaults\n");
+    printf("                   to $RMBRL_BACKEND (not on Windows)\n");
+    printf("      --format     Output format for memories: text (default), tsv, json, ndjson or\n");
+    printf("                   csv, machine-readable formats are written to stdout\n");
+}
+
+// Shell completion
+//
+// `rmbrl complete bash|zsh|fish` prints one of these, they complete commands and flags and ask
+// `rmbrl complete projects <prefix>` for the project names after -p and --project.
+
+#define RMBRL_COMPLETION_COMMANDS                                                                  \
+    "add peek due clear search projects stats gc export import complete compact exec init serve "  \
+    "backup restore"
+#define RMBRL_COMPLETION_FLAGS                                                                     \
+    "--project --tag --stdin --null --batch-size --due --all --limit --older-than --archive "      \
+    "--after --cached --global --by-due --watch --window --compact --help --version --verbose "    \
+    "--silent --dry-run --stats --db --busy-timeout --timeout-ms --backend --format"
+
+static const char rmbrl_completion_bash[] =
+    "_rmbrl()\n"
+    "{\n"
+    "    local cur=\"${COMP_WORDS[COMP_CWORD]}\" prev=\"${COMP_WORDS[COMP_CWORD - 1]}\"\n"
+    "    case \"$prev\" in\n"
+    "    -p | --project)\n"
+    "        local IFS=$'\\n'\n"
+    "        COMPREPLY=($(rmbrl complete projects \"$cur\" 2>/dev/null))\n"
+    "        return\n"
+    "        ;;\n"
+    "    --format)\n"
+    "        COMPREPLY=($(compgen -W \"text tsv json ndjson csv\" -- \"$cur\"))\n"
+    "        return\n"
+    "        ;;\n"
+    "    --backend)\n"
+    "        COMPREPLY=($(compgen -W \"sqlite log\" -- \"$cur\"))\n"
+    "        return\n"
+    "        ;;\n"
+    "    --db | exec | backup | restore)\n"
+    "        COMPREPLY=($(compgen -f -- \"$cur\"))\n"
+    "        return\n"
+    "        ;;\n"
+    "    esac\n"
+    "    if [ \"$COMP_CWORD\" -eq 1 ]; then\n"
+    "        COMPREPLY=($(compgen -W \"" RMBRL_COMPLETION_COMMANDS "\" -- \"$cur\"))\n"
+    "    elif [[ \"$cur\" == -* ]]; then\n"
+    "        COMPREPLY=($(compgen -W \"" RMBRL_COMPLETION_FLAGS "\" -- \"$cur\"))\n"
+    "    fi\n"
+    "}\n"
+    "complete -F _rmbrl rmbrl\n";
+
+static const char rmbrl_completion_zsh[] =
+    "#compdef rmbrl\n"
+    "_rmbrl_projects()\n"
+    "{\n"
+    "    local -a projects\n"
+    "    projects=(${(f)\"$(rmbrl complete projects \"$PREFIX\" 2>/dev/null)\"})\n"
+    "    compadd -a projects\n"
+    "}\n"
+    "_rmbrl()\n"
+    "{\n"
+    "    case \"${words[CURRENT - 1]}\" in\n"
+    "    -p | --project) _rmbrl_projects ;;\n"
+    "    --format) compadd text tsv json ndjson csv ;;\n"
+    "    --backend) compadd sqlite log ;;\n"
+    "    --db | exec | backup | restore) _files ;;\n"
+    "    *)\n"
+    "        if (( CURRENT == 2 )); then\n"
+    "            compadd " RMBRL_COMPLETION_COMMANDS "\n"
+    "        elif [[ \"$PREFIX\" == -* ]]; then\n"
+    "            compadd -- " RMBRL_COMPLETION_FLAGS "\n"
+    "        fi\n"
+    "        ;;\n"
+    "    esac\n"
+    "}\n"
+    "compdef _rmbrl rmbrl\n";
+
+static const char rmbrl_completion_fish[] =
+    "complete -c rmbrl -f\n"
+    "complete -c rmbrl -n __fish_use_subcommand -a \"" RMBRL_COMPLETION_COMMANDS "\"\n"
+    "complete -c rmbrl -s p -l project -x -a "
+    "\"(rmbrl complete projects (commandline -ct | string replace -r -- '^(--project=|-p)' '') "
+    "2>/dev/null)\"\n"
+    "complete -c rmbrl -l format -x -a \"text tsv json ndjson csv\"\n"
+    "complete -c rmbrl -l db -r -F\n"
+    "complete -c rmbrl -n \"__fish_seen_subcommand_from exec\" -F\n"
+    "complete -c rmbrl -s a -l all\n"
+    "complete -c rmbrl -s l -l limit -x\n"
+    "complete -c rmbrl -s n -l dry-run\n"
+    "complete -c rmbrl -s s -l silent\n"
+    "complete -c rmbrl -s v -l verbose\n"
+    "complete -c rmbrl -s 0 -l null\n"
+    "complete -c rmbrl -l stdin\n"
+    "complete -c rmbrl -l batch-size -x\n"
+    "complete -c rmbrl -l older-than -x\n"
+    "complete -c rmbrl -l archive\n"
+    "complete -c rmbrl -l after -x\n"
+    "complete -c rmbrl -l cached\n"
+    "complete -c rmbrl -l watch\n"
+    "complete -c rmbrl -l compact\n"
+    "complete -c rmbrl -n \"__fish_seen_subcommand_from backup restore\" -F\n"
+    "complete -c rmbrl -l global\n"
+    "complete -c rmbrl -l stats\n"
+    "complete -c rmbrl -l busy-timeout -x\n"
+    "complete -c rmbrl -l timeout-ms -x\n"
+    "complete -c rmbrl -l backend -x -a \"sqlite log\"\n";
+
+const char *rmbrl_completion_script(const char *shell)
+{
+    if (strcmp(shell, "bash") == 0)
+        return rmbrl_completion_bash;
+    if (strcmp(shell, "zsh") == 0)
+        return rmbrl_completion_zsh;
+    if (strcmp(shell, "fish") == 0)
+        return rmbrl_completion_fish;
+    return NULL;
 }
 
 typedef enum
@@ -135,8 +549,15 @@ typedef enum
     RMBRL_LOG_ERROR,
 } Rmbrl_Log_Level;
 
+// Set once the invocation ran out of its --timeout-ms budget, see "Latency budget". The errors
+// after that only come from what the budget interrupted, the exit code reports it instead.
+static bool rmbrl_log_quiet;
+
 void rmbrl_log(Rmbrl_Log_Level level, const char *fmt, ...)
 {
+    if (level == RMBRL_LOG_ERROR && rmbrl_log_quiet)
+        return;
+
     switch (level)
     {
     case RMBRL_LOG_INFO:
@@ -164,6 +585,20 @@ typedef enum
     RMBRL_CMD_ADD,
     RMBRL_CMD_PEEK,
     RMBRL_CMD_CLEAR,
+    RMBRL_CMD_SEARCH,
+    RMBRL_CMD_PROJECTS,
+    RMBRL_CMD_GC,
+    RMBRL_CMD_EXPORT,
+    RMBRL_CMD_IMPORT,
+    RMBRL_CMD_COMPLETE,
+    RMBRL_CMD_COMPACT,
+    RMBRL_CMD_STATS,
+    RMBRL_CMD_DUE,
+    RMBRL_CMD_EXEC,
+    RMBRL_CMD_INIT,
+    RMBRL_CMD_SERVE,
+    RMBRL_CMD_BACKUP,
+    RMBRL_CMD_RESTORE,
 } Rmbrl_Command_Function;
 
 char *rmbrl_command_function_str(Rmbrl_Command_Function func)
@@ -178,19 +613,110 @@ char *rmbrl_command_function_str(Rmbrl_Command_Function func)
         return "peek";
     case RMBRL_CMD_CLEAR:
         return "clear";
+    case RMBRL_CMD_SEARCH:
+        return "search";
+    case RMBRL_CMD_PROJECTS:
+        return "projects";
+    case RMBRL_CMD_GC:
+        return "gc";
+    case RMBRL_CMD_EXPORT:
+        return "export";
+    case RMBRL_CMD_IMPORT:
+        return "import";
+    case RMBRL_CMD_COMPLETE:
+        return "complete";
+    case RMBRL_CMD_COMPACT:
+        return "compact";
+    case RMBRL_CMD_STATS:
+        return "stats";
+    case RMBRL_CMD_DUE:
+        return "due";
+    case RMBRL_CMD_EXEC:
+        return "exec";
+    case RMBRL_CMD_INIT:
+        return "init";
+    case RMBRL_CMD_SERVE:
+        return "serve";
+    case RMBRL_CMD_BACKUP:
+        return "backup";
+    case RMBRL_CMD_RESTORE:
+        return "restore";
     default:
         RMBRL_UNREACHABLE("command function str");
     }
 }
 
+typedef enum
+{
+    RMBRL_FORMAT_TEXT = 0,
+    RMBRL_FORMAT_TSV,
+    RMBRL_FORMAT_JSON,
+    RMBRL_FORMAT_NDJSON,
+    RMBRL_FORMAT_CSV,
+} Rmbrl_Format;
+
+char *rmbrl_format_str(Rmbrl_Format format)
+{
+    switch (format)
+    {
+    case RMBRL_FORMAT_TEXT:
+        return "text";
+    case RMBRL_FORMAT_TSV:
+        return "tsv";
+    case RMBRL_FORMAT_JSON:
+        return "json";
+    case RMBRL_FORMAT_NDJSON:
+        return "ndjson";
+    case RMBRL_FORMAT_CSV:
+        return "csv";
+    default:
+        RMBRL_UNREACHABLE("format str");
+    }
+}
+
+typedef enum
+{
+    RMBRL_BACKEND_SQLITE = 0,
+    RMBRL_BACKEND_LOG, // add appends to the write log, see "Write log"
+} Rmbrl_Backend;
+
 typedef struct
 {
     Rmbrl_Command_Function function;
     Rmbrl_Verbosity_Level verbosity;
+    Rmbrl_Format format;
     char *project;
     char *task;
+    char *query;
     bool all;
     bool dry_run;
+    bool has_limit;
+    sqlite3_int64 limit;
+    sqlite3_int64 after_id;      // keyset cursor, 0 when not provided
+    sqlite3_int64 older_than_ms; // clear and gc --older-than, 0 when not provided
+    bool archive;                // clear --archive, keep forgotten memories until `rmbrl gc`
+    sqlite3_int64 due_at;        // add --due, 0 when not provided
+    sqlite3_int64 window_ms;     // due --window, how far ahead of now memories are due
+    bool by_due;                 // peek --by-due, soonest due date first instead of newest
+    bool watch;                  // peek --watch, print the page again whenever it changes
+    char *tags[RMBRL_MAX_TAGS];  // -t, --tag, the tags of add or the ones peek and due require
+    size_t tags_count;
+    char *db_override; // --db, takes precedence over RMBRL_DB
+    bool cached;       // peek --cached, serve from the snapshot when it is current
+    bool global;       // peek --global, merge the global store with every repository store
+    int busy_timeout_ms;
+    int timeout_ms; // --timeout-ms, budget of the whole invocation, 0 without one
+    bool from_stdin;
+    FILE *input; // stdin, or the stdin of the client when run by `rmbrl serve`
+    bool null_delimited;
+    size_t batch_size; // rows per transaction for add --stdin
+    bool stats;        // --stats, report where the invocation spent its time
+    char *script;      // exec, path of the script or "-" for stdin
+    char *path;        // backup and restore, the file of the backup
+    bool compact;      // backup --compact, write it with VACUUM INTO
+    char *complete;    // complete, "projects" or the shell to print the completion script for
+    char *prefix;      // complete projects, only names starting with it
+    Rmbrl_Backend backend;
 } Rmbrl_Command;
 
 typedef struct
@@ -221,192 +747,5458 @@ void rmbrl_command_debug_print(Rmbrl_Command *cmd)
     rmbrl_log(RMBRL_LOG_INFO, "Parsed Command Line Args:\n");
     rmbrl_log(RMBRL_LOG_INFO, "    function: %s\n", rmbrl_command_function_str(cmd->function));
     rmbrl_log(RMBRL_LOG_INFO, "    task: %s\n", cmd->task);
+    rmbrl_log(RMBRL_LOG_INFO, "    query: %s\n", cmd->query);
+    if (cmd->function == RMBRL_CMD_COMPLETE)
+    {
+        rmbrl_log(RMBRL_LOG_INFO, "    complete: %s\n", cmd->complete);
+        rmbrl_log(RMBRL_LOG_INFO, "    prefix: %s\n", cmd->prefix);
+    }
     rmbrl_log(RMBRL_LOG_INFO, "    project: %s\n", cmd->project);
+    for (size_t i = 0; i < cmd->tags_count; ++i)
+        rmbrl_log(RMBRL_LOG_INFO, "    tag: %s\n", cmd->tags[i]);
     rmbrl_log(RMBRL_LOG_INFO, "    all: %s\n", cmd->all ? "true" : "false");
     rmbrl_log(RMBRL_LOG_INFO, "    dry-run: %s\n", cmd->dry_run ? "true" : "false");
+    if (cmd->has_limit)
+        rmbrl_log(RMBRL_LOG_INFO, "    limit: %lld\n", (long long)cmd->limit);
+    else
+        rmbrl_log(RMBRL_LOG_INFO, "    limit: (null)\n");
+    rmbrl_log(RMBRL_LOG_INFO, "    after: %lld\n", (long long)cmd->after_id);
+    rmbrl_log(RMBRL_LOG_INFO, "    older-than: %lldms\n", (long long)cmd->older_than_ms);
+    rmbrl_log(RMBRL_LOG_INFO, "    archive: %s\n", cmd->archive ? "true" : "false");
+    if (cmd->function == RMBRL_CMD_ADD)
+        rmbrl_log(RMBRL_LOG_INFO, "    due: %lld\n", (long long)cmd->due_at);
+    if (cmd->function == RMBRL_CMD_DUE)
+        rmbrl_log(RMBRL_LOG_INFO, "    window: %lldms\n", (long long)cmd->window_ms);
+    rmbrl_log(RMBRL_LOG_INFO, "    by-due: %s\n", cmd->by_due ? "true" : "false");
+    rmbrl_log(RMBRL_LOG_INFO, "    watch: %s\n", cmd->watch ? "true" : "false");
+    rmbrl_log(RMBRL_LOG_INFO, "    cached: %s\n", cmd->cached ? "true" : "false");
+    rmbrl_log(RMBRL_LOG_INFO, "    global: %s\n", cmd->global ? "true" : "false");
+    rmbrl_log(RMBRL_LOG_INFO, "    stdin: %s\n", cmd->from_stdin ? "true" : "false");
+    if (cmd->from_stdin || cmd->function == RMBRL_CMD_IMPORT)
+    {
+        rmbrl_log(RMBRL_LOG_INFO, "    null: %s\n", cmd->null_delimited ? "true" : "false");
+        rmbrl_log(RMBRL_LOG_INFO, "    batch-size: %zu\n", cmd->batch_size);
+    }
+    rmbrl_log(RMBRL_LOG_INFO, "    format: %s\n", rmbrl_format_str(cmd->format));
+    rmbrl_log(RMBRL_LOG_INFO, "    backend: %s\n",
+              cmd->backend == RMBRL_BACKEND_LOG ? "log" : "sqlite");
+    rmbrl_log(RMBRL_LOG_INFO, "    stats: %s\n", cmd->stats ? "true" : "false");
+    rmbrl_log(RMBRL_LOG_INFO, "    timeout: %dms\n", cmd->timeout_ms);
     rmbrl_log(RMBRL_LOG_INFO, "    verbosity: %s\n", cmd_verbosity);
 }
 
+// Stats
 //
-// NOTES:
-//
-// Use sqlite3_exec when statement does not use user supplied input
-// Otherwise, manually prepare the statement to prevent SQL Injections.
-//
-// SQLITE_ENABLE_UPDATE_DELETE_LIMIT Compile time flag is off by default.
-// Therefore, we cannot reliably use ORDER BY with DELETE or UPDATE.
-// So, in order to delete the most recent item, --all is NOT passed, then we will
-// have to fetch that item first and then delete by ID.
-// Otherwise, if --all flag is passed, we don't need to fetch first.
-//
+// --stats reports where an invocation spent its time as one JSON line on stderr. Phases are
+// measured with a monotonic clock: argument parsing, resolving the database path (including
+// creating its directory), opening the connection, schema migrations, preparing statements,
+// stepping them and writing output. Stepping is whatever the command spent outside of preparing
+// and output, so the phases add up to the total. SQLite's page cache and memory counters are read
+// once the command finished, statement counters are summed up as statements are released.
 
-int rmbrl_db_begin_transaction(sqlite3 *db, Rmbrl_Verbosity_Level verbosity)
+typedef struct
 {
-    char *err_msg;
-    if (sqlite3_exec(db, "BEGIN TRANSACTION;", NULL, 0, &err_msg) != SQLITE_OK)
-    {
-        rmbrl_log(RMBRL_LOG_ERROR, "Failed to begin transaction: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        return 1;
-    }
+    bool enabled;
+    const char *command;
+    sqlite3_int64 start_ns;
+    sqlite3_int64 parse_ns;
+    sqlite3_int64 path_ns;
+    sqlite3_int64 open_ns;
+    sqlite3_int64 schema_ns;
+    sqlite3_int64 run_ns; // the command, split into prepare, output and step
+    sqlite3_int64 prepare_ns;
+    sqlite3_int64 output_ns;
+    sqlite3_int64 prepared; // statements compiled, not served from the statement cache
+    sqlite3_int64 fullscan_steps;
+    sqlite3_int64 sorts;
+    sqlite3_int64 autoindexes;
+    sqlite3_int64 vm_steps;
+    int cache_hit;
+    int cache_miss;
+    int cache_write;
+} Rmbrl_Stats;
 
-    if (verbosity == RMBRL_VERB_VERBOSE)
-        rmbrl_log(RMBRL_LOG_INFO, "Begin transaction...\n");
+static Rmbrl_Stats rmbrl_stats;
 
-    return 0;
+sqlite3_int64 rmbrl_stats_now_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (sqlite3_int64)(counter.QuadPart / frequency.QuadPart * 1000000000 +
+                           counter.QuadPart % frequency.QuadPart * 1000000000 /
+                               frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (sqlite3_int64)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif // end _WIN32
 }
 
-int rmbrl_db_rollback_transaction(sqlite3 *db, Rmbrl_Verbosity_Level verbosity)
+// Ends the phase that started at *mark by adding its duration to *phase, the next one starts now.
+void rmbrl_stats_phase(sqlite3_int64 *phase, sqlite3_int64 *mark)
 {
-    char *err_msg;
-    if (sqlite3_exec(db, "ROLLBACK;", NULL, 0, &err_msg) != SQLITE_OK)
-    {
-        rmbrl_log(RMBRL_LOG_ERROR, "Failed to rollback transaction: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        return 1;
-    }
+    sqlite3_int64 now = rmbrl_stats_now_ns();
+    *phase += now - *mark;
+    *mark = now;
+}
 
-    if (verbosity == RMBRL_VERB_VERBOSE)
-        rmbrl_log(RMBRL_LOG_INFO, "Rollback transaction...\n");
+// Starts timing a step that is repeated per statement or row, cheap enough when --stats is off.
+static inline sqlite3_int64 rmbrl_stats_start(void)
+{
+    return rmbrl_stats.enabled ? rmbrl_stats_now_ns() : 0;
+}
 
-    return 0;
+static inline void rmbrl_stats_stop(sqlite3_int64 *phase, sqlite3_int64 start)
+{
+    if (rmbrl_stats.enabled)
+        *phase += rmbrl_stats_now_ns() - start;
 }
 
-int rmbrl_command_add(Rmbrl_Command *cmd, sqlite3 *db)
+// Resets the counters for a new invocation, including SQLite's high-water marks, so every request
+// of `rmbrl serve` reports its own.
+void rmbrl_stats_begin(void)
 {
-    if (strlen(cmd->task) > 256)
-    {
-        rmbrl_log(RMBRL_LOG_ERROR, "Task \"%s\" exceeds char limit of 256 bytes.\n", cmd->task);
-        return 1;
-    }
-    if (cmd->project && strlen(cmd->project) > 256)
-    {
-        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
-                  cmd->project);
-        return 1;
-    }
+    rmbrl_stats = (Rmbrl_Stats){.start_ns = rmbrl_stats_now_ns()};
 
-    if (cmd->dry_run)
+    static const int ops[] = {SQLITE_STATUS_MEMORY_USED, SQLITE_STATUS_MALLOC_COUNT,
+                              SQLITE_STATUS_PAGECACHE_USED, SQLITE_STATUS_PAGECACHE_OVERFLOW};
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i)
     {
-        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. Memory will NOT be remembered!\n");
-        int result = rmbrl_db_begin_transaction(db, cmd->verbosity);
-        if (result != 0)
-            return result;
+        sqlite3_int64 current, highwater;
+        sqlite3_status64(ops[i], &current, &highwater, 1);
     }
+}
 
-    sqlite3_stmt *stmt;
-    const char *raw_stmt = "INSERT INTO memories (task, project) VALUES (?, ?);";
-    if (sqlite3_prepare_v2(db, raw_stmt, -1, &stmt, NULL) != SQLITE_OK)
-    {
-        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        return 1;
-    }
+void rmbrl_stats_statement(sqlite3_stmt *stmt)
+{
+    rmbrl_stats.fullscan_steps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    rmbrl_stats.sorts += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+    rmbrl_stats.autoindexes += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+    rmbrl_stats.vm_steps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+}
 
-    sqlite3_bind_text(stmt, 1, cmd->task, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, cmd->project ? cmd->project : "", -1, SQLITE_STATIC);
+void rmbrl_stats_connection(sqlite3 *db)
+{
+    if (!rmbrl_stats.enabled || db == NULL)
+        return;
 
-    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
-    {
-        char *stmt_str = sqlite3_expanded_sql(stmt);
-        rmbrl_log(RMBRL_LOG_INFO, "Query: %s\n", stmt_str);
-    }
+    int highwater;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &rmbrl_stats.cache_hit, &highwater, 1);
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &rmbrl_stats.cache_miss, &highwater, 1);
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_WRITE, &rmbrl_stats.cache_write, &highwater, 1);
+}
 
-    int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+void rmbrl_stats_report(int code)
+{
+    Rmbrl_Stats *stats = &rmbrl_stats;
+    if (!stats->enabled)
+        return;
 
-    if (result != SQLITE_DONE)
-    {
-        rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember: %s\n", sqlite3_errmsg(db));
-        return 1;
-    }
+    sqlite3_int64 total_ns = rmbrl_stats_now_ns() - stats->start_ns;
+    sqlite3_int64 step_ns = stats->run_ns - stats->prepare_ns - stats->output_ns;
+    sqlite3_int64 current, memory_max, mallocs_max, pagecache_max, overflow_max;
+    sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &current, &memory_max, 0);
+    sqlite3_status64(SQLITE_STATUS_MALLOC_COUNT, &current, &mallocs_max, 0);
+    sqlite3_status64(SQLITE_STATUS_PAGECACHE_USED, &current, &pagecache_max, 0);
+    sqlite3_status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, &current, &overflow_max, 0);
 
-    rmbrl_log(RMBRL_LOG_INFO, "\"%s\" was added to your memory!\n", cmd->task);
+    fflush(stdout);
+    fprintf(stderr,
+            "{\"command\":\"%s\",\"exit\":%d,\"total_us\":%lld,\"parse_us\":%lld,"
+            "\"path_us\":%lld,\"open_us\":%lld,\"schema_us\":%lld,\"prepare_us\":%lld,"
+            "\"step_us\":%lld,\"output_us\":%lld,\"prepared\":%lld,\"cache_hit\":%d,"
+            "\"cache_miss\":%d,\"cache_write\":%d,\"memory_used_max\":%lld,"
+            "\"malloc_count_max\":%lld,\"pagecache_used_max\":%lld,"
+            "\"pagecache_overflow_max\":%lld,\"fullscan_steps\":%lld,\"sorts\":%lld,"
+            "\"autoindexes\":%lld,\"vm_steps\":%lld}\n",
+            stats->command ? stats->command : "", code, (long long)(total_ns / 1000),
+            (long long)(stats->parse_ns / 1000), (long long)(stats->path_ns / 1000),
+            (long long)(stats->open_ns / 1000), (long long)(stats->schema_ns / 1000),
+            (long long)(stats->prepare_ns / 1000), (long long)(step_ns / 1000),
+            (long long)(stats->output_ns / 1000), (long long)stats->prepared, stats->cache_hit,
+            stats->cache_miss, stats->cache_write, (long long)memory_max, (long long)mallocs_max,
+            (long long)pagecache_max, (long long)overflow_max, (long long)stats->fullscan_steps,
+            (long long)stats->sorts, (long long)stats->autoindexes, (long long)stats->vm_steps);
+    fflush(stderr);
+}
 
-    if (cmd->dry_run)
-    {
-        result = rmbrl_db_rollback_transaction(db, cmd->verbosity);
-        if (result != 0)
-            return result;
-    }
+// Output
+//
+// Rows are written into a fixed buffer that is flushed with a single fwrite once full, instead of
+// several unbuffered writes to stderr per row. The text format keeps the log layout on stderr,
+// the machine-readable formats go to stdout without the log prefix so scripts can consume them.
 
-    return 0;
-}
+#ifndef RMBRL_OUT_CAP
+#define RMBRL_OUT_CAP (64 * 1024)
+#endif
 
-int rmbrl_command_peek(Rmbrl_Command *cmd, sqlite3 *db)
+typedef struct
 {
-    if (cmd->project && strlen(cmd->project) > 256)
-    {
-        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
-                  cmd->project);
-        return 1;
-    }
-
-    sqlite3_stmt *stmt;
-    char *raw_stmt;
+    FILE *file;
+    Rmbrl_Format format;
+    Rmbrl_Verbosity_Level verbosity;
+    size_t rows;
+    size_t count;
+    bool precise; // timestamps keep their milliseconds, so an export restores them exactly
+    bool due;          // rows select due_at after RMBRL_MEMORY_COLUMNS, it is written as well
+    bool tags;         // rows select the tags of the memory last, NUL separated, export writes them
+    const char *store; // peek --global, the path of the store the next row comes from
+    sqlite3_int64 now; // with due, the text format marks memories due before it as overdue
+    bool changed_only; // peek --watch, rmbrl_out_end drops output that repeats the last one
+    bool spilled;      // buf was flushed before rmbrl_out_end, it cannot be compared
+    char buf[RMBRL_OUT_CAP];
+} Rmbrl_Out;
 
-    if (cmd->project)
-        raw_stmt = "SELECT * FROM memories WHERE project = ? ORDER BY created_at DESC;";
-    else
-        raw_stmt = "SELECT * FROM memories ORDER BY created_at DESC;";
+// The last output written with changed_only
+typedef struct
+{
+    bool valid;
+    size_t count;
+    char buf[RMBRL_OUT_CAP];
+} Rmbrl_Out_Last;
 
-    if (sqlite3_prepare_v2(db, raw_stmt, -1, &stmt, NULL) != SQLITE_OK)
-    {
-        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        return 1;
-    }
+static Rmbrl_Out_Last rmbrl_out_last;
 
-    if (cmd->project)
-        sqlite3_bind_text(stmt, 1, cmd->project, -1, SQLITE_STATIC);
+void rmbrl_out_flush(Rmbrl_Out *out)
+{
+    if (out->count > 0)
+        fwrite(out->buf, 1, out->count, out->file);
+    out->count = 0;
+    fflush(out->file);
+}
 
-    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+void rmbrl_out_write(Rmbrl_Out *out, const char *data, size_t size)
+{
+    if (out->count + size > RMBRL_OUT_CAP)
     {
-        char *stmt_str = sqlite3_expanded_sql(stmt);
-        rmbrl_log(RMBRL_LOG_INFO, "Query: %s\n", stmt_str);
+        out->spilled = true;
+        rmbrl_out_flush(out);
+        if (size > RMBRL_OUT_CAP)
+        {
+            fwrite(data, 1, size, out->file);
+            return;
+        }
     }
+    memcpy(out->buf + out->count, data, size);
+    out->count += size;
+}
 
-    if (cmd->verbosity != RMBRL_VERB_SILENT)
-        rmbrl_log(RMBRL_LOG_INFO, "Currently Remembering:\n");
-
-    int result;
-    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
-    {
-        // int id = sqlite3_column_int(stmt, 0);
-
-        const unsigned char *task = sqlite3_column_text(stmt, 1);
-        rmbrl_log(RMBRL_LOG_INFO, "    \"%s\"", task);
+void rmbrl_out_cstr(Rmbrl_Out *out, const char *cstr)
+{
+    rmbrl_out_write(out, cstr, strlen(cstr));
+}
 
-        const char *project = (char *)sqlite3_column_text(stmt, 2);
-        if (strlen(project) > 0)
-            fprintf(stderr, " -- %s", project);
+void rmbrl_out_int(Rmbrl_Out *out, sqlite3_int64 value)
+{
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%lld", (long long)value);
+    rmbrl_out_write(out, buf, (size_t)len);
+}
 
-        if (cmd->verbosity == RMBRL_VERB_VERBOSE)
-        {
-            char *created_at = rmbrl_strdup((char *)sqlite3_column_text(stmt, 3));
-            created_at[10] = '\0';
-            fprintf(stderr, " -- %s", created_at);
-            RMBRL_FREE(created_at);
-        }
+void rmbrl_out_json_str(Rmbrl_Out *out, const unsigned char *str, int size)
+{
+    static const char hex[] = "0123456789abcdef";
+    rmbrl_out_write(out, "\"", 1);
 
-        fprintf(stderr, "\n");
+    // copy runs of plain bytes in one go and only break them up for characters to escape
+    int start = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        unsigned char c = str[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
 
-        if (!cmd->all)
+        rmbrl_out_write(out, (const char *)str + start, (size_t)(i - start));
+        start = i + 1;
+        switch (c)
         {
-            result = SQLITE_DONE;
+        case '"':
+            rmbrl_out_write(out, "\\\"", 2);
+            break;
+        case '\\':
+            rmbrl_out_write(out, "\\\\", 2);
+            break;
+        case '\n':
+            rmbrl_out_write(out, "\\n", 2);
             break;
+        case '\r':
+            rmbrl_out_write(out, "\\r", 2);
+            break;
+        case '\t':
+            rmbrl_out_write(out, "\\t", 2);
+            break;
+        default: {
+            char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            rmbrl_out_write(out, escaped, sizeof(escaped));
+        }
+        break;
         }
     }
+    rmbrl_out_write(out, (const char *)str + start, (size_t)(size - start));
+
+    rmbrl_out_write(out, "\"", 1);
+}
+
+// Tabs, newlines and backslashes inside of a field are escaped, so every row stays on one line.
+void rmbrl_out_tsv_str(Rmbrl_Out *out, const unsigned char *str, int size)
+{
+    int start = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        char c = (char)str[i];
+        if (c != '\t' && c != '\n' && c != '\r' && c != '\\')
+            continue;
+
+        rmbrl_out_write(out, (const char *)str + start, (size_t)(i - start));
+        start = i + 1;
+        char escaped[2] = {'\\', c == '\t' ? 't' : c == '\n' ? 'n' : c == '\r' ? 'r' : '\\'};
+        rmbrl_out_write(out, escaped, sizeof(escaped));
+    }
+    rmbrl_out_write(out, (const char *)str + start, (size_t)(size - start));
+}
+
+// RFC 4180 quoting, fields containing a comma, quote or line break are quoted and quotes doubled.
+void rmbrl_out_csv_str(Rmbrl_Out *out, const unsigned char *str, int size)
+{
+    bool quote = false;
+    for (int i = 0; i < size && !quote; ++i)
+        quote = str[i] == ',' || str[i] == '"' || str[i] == '\n' || str[i] == '\r';
+    if (!quote)
+    {
+        rmbrl_out_write(out, (const char *)str, (size_t)size);
+        return;
+    }
+
+    rmbrl_out_write(out, "\"", 1);
+    int start = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        if (str[i] != '"')
+            continue;
+        // the quote is written again as the start of the next run
+        rmbrl_out_write(out, (const char *)str + start, (size_t)(i + 1 - start));
+        start = i;
+    }
+    rmbrl_out_write(out, (const char *)str + start, (size_t)(size - start));
+    rmbrl_out_write(out, "\"", 1);
+}
+
+// "YYYY-MM-DD HH:MM:SS.mmm" plus its terminator. The text format only prints the date part, the
+// others stop at the seconds unless the output is precise.
+#define RMBRL_TIMESTAMP_SIZE 24
+#define RMBRL_TIMESTAMP_DATE_LEN 10
+#define RMBRL_TIMESTAMP_MINUTES_LEN 16
+#define RMBRL_TIMESTAMP_SECONDS_LEN 19
+
+static inline void rmbrl_format_digits(char *dst, int value, int digits)
+{
+    for (int i = digits - 1; i >= 0; --i, value /= 10)
+        dst[i] = (char)('0' + value % 10);
+}
+
+// Formats created_at, milliseconds since the unix epoch, as a UTC timestamp into buf. The date is
+// computed with civil_from_days from http://howardhinnant.github.io/date_algorithms.html instead
+// of gmtime, which is not reentrant and goes through the C library's time zone handling.
+void rmbrl_format_timestamp(sqlite3_int64 created_at, char buf[RMBRL_TIMESTAMP_SIZE])
+{
+    sqlite3_int64 secs = created_at / 1000 - (created_at % 1000 < 0);
+    sqlite3_int64 days = secs / 86400 - (secs % 86400 < 0);
+    int day_secs = (int)(secs - days * 86400);
+
+    sqlite3_int64 z = days + 719468;
+    sqlite3_int64 era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = (int)(z - era * 146097);
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int day = doy - (153 * mp + 2) / 5 + 1;
+    int month = mp < 10 ? mp + 3 : mp - 9;
+    sqlite3_int64 year = era * 400 + yoe + (month <= 2);
+    if (year < 0)
+        year = 0;
+    else if (year > 9999)
+        year = 9999;
+
+    memcpy(buf, "0000-00-00 00:00:00.000", RMBRL_TIMESTAMP_SIZE);
+    rmbrl_format_digits(buf, (int)year, 4);
+    rmbrl_format_digits(buf + 5, month, 2);
+    rmbrl_format_digits(buf + 8, day, 2);
+    rmbrl_format_digits(buf + 11, day_secs / 3600, 2);
+    rmbrl_format_digits(buf + 14, day_secs / 60 % 60, 2);
+    rmbrl_format_digits(buf + 17, day_secs % 60, 2);
+    rmbrl_format_digits(buf + 20, (int)(created_at - secs * 1000), 3);
+}
+
+// Current time in the unit of created_at and due_at, milliseconds since the unix epoch
+sqlite3_int64 rmbrl_now_ms(void)
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (sqlite3_int64)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void rmbrl_out_begin(Rmbrl_Out *out, Rmbrl_Format format, Rmbrl_Verbosity_Level verbosity)
+{
+    out->file = format == RMBRL_FORMAT_TEXT ? stderr : stdout;
+    out->format = format;
+    out->verbosity = verbosity;
+    out->rows = 0;
+    out->count = 0;
+    out->precise = false;
+    out->due = false;
+    out->tags = false;
+    out->store = NULL;
+    out->changed_only = false;
+    out->spilled = false;
+
+    if (format == RMBRL_FORMAT_JSON)
+        rmbrl_out_write(out, "[", 1);
+}
+
+// Writes the tags of a memory, NUL separated, as one field of the delimited formats separated by
+// spaces. Tags never contain NUL, but a tag containing a space is split up when read back.
+void rmbrl_out_tags_joined(Rmbrl_Out *out, const unsigned char *tags, int tags_size)
+{
+    char joined[RMBRL_MAX_TAGS * (256 + 1)];
+    int size = tags_size < (int)sizeof(joined) ? tags_size : (int)sizeof(joined);
+    for (int i = 0; i < size; ++i)
+        joined[i] = tags[i] == '\0' ? ' ' : (char)tags[i];
+    if (out->format == RMBRL_FORMAT_CSV)
+        rmbrl_out_csv_str(out, (const unsigned char *)joined, size);
+    else
+        rmbrl_out_tsv_str(out, (const unsigned char *)joined, size);
+}
+
+// due_at is only written when out->due is set, 0 for a memory without a due date. tags, NUL
+// separated, only when out->tags is set.
+void rmbrl_out_memory_fields(Rmbrl_Out *out, sqlite3_int64 id, const unsigned char *task,
+                             int task_size, const unsigned char *project, int project_size,
+                             sqlite3_int64 created_at, sqlite3_int64 due_at,
+                             const unsigned char *tags, int tags_size)
+{
+    sqlite3_int64 start = rmbrl_stats_start();
+    char timestamp[RMBRL_TIMESTAMP_SIZE];
+    rmbrl_format_timestamp(created_at, timestamp);
+    size_t timestamp_len = out->precise ? RMBRL_TIMESTAMP_SIZE - 1 : RMBRL_TIMESTAMP_SECONDS_LEN;
+    char due[RMBRL_TIMESTAMP_SIZE];
+    bool has_due = out->due && due_at != 0;
+    if (has_due)
+        rmbrl_format_timestamp(due_at, due);
+
+    switch (out->format)
+    {
+    case RMBRL_FORMAT_TEXT:
+        rmbrl_out_cstr(out, "[INFO]     \"");
+        rmbrl_out_write(out, (const char *)task, (size_t)task_size);
+        rmbrl_out_write(out, "\"", 1);
+        if (project_size > 0)
+        {
+            rmbrl_out_write(out, " -- ", 4);
+            rmbrl_out_write(out, (const char *)project, (size_t)project_size);
+        }
+        if (has_due)
+        {
+            rmbrl_out_write(out, " -- due ", 8);
+            rmbrl_out_write(out, due, RMBRL_TIMESTAMP_MINUTES_LEN);
+            if (due_at <= out->now)
+                rmbrl_out_cstr(out, " (overdue)");
+        }
+        if (out->verbosity == RMBRL_VERB_VERBOSE)
+        {
+            rmbrl_out_write(out, " -- ", 4);
+            rmbrl_out_write(out, timestamp, RMBRL_TIMESTAMP_DATE_LEN);
+
+            // the id is the cursor for --after
+            rmbrl_out_write(out, " -- #", 5);
+            rmbrl_out_int(out, id);
+            if (out->store != NULL)
+            {
+                rmbrl_out_cstr(out, " in ");
+                rmbrl_out_cstr(out, out->store);
+            }
+        }
+        rmbrl_out_write(out, "\n", 1);
+        break;
+    case RMBRL_FORMAT_TSV:
+        rmbrl_out_int(out, id);
+        rmbrl_out_write(out, "\t", 1);
+        rmbrl_out_tsv_str(out, task, task_size);
+        rmbrl_out_write(out, "\t", 1);
+        rmbrl_out_tsv_str(out, project, project_size);
+        rmbrl_out_write(out, "\t", 1);
+        rmbrl_out_write(out, timestamp, timestamp_len);
+        if (out->due)
+            rmbrl_out_write(out, "\t", 1);
+        if (has_due)
+            rmbrl_out_write(out, due, timestamp_len);
+        if (out->tags)
+        {
+            rmbrl_out_write(out, "\t", 1);
+            rmbrl_out_tags_joined(out, tags, tags_size);
+        }
+        if (out->store != NULL)
+        {
+            rmbrl_out_write(out, "\t", 1);
+            rmbrl_out_tsv_str(out, (const unsigned char *)out->store, (int)strlen(out->store));
+        }
+        rmbrl_out_write(out, "\n", 1);
+        break;
+    case RMBRL_FORMAT_JSON:
+    case RMBRL_FORMAT_NDJSON:
+        if (out->format == RMBRL_FORMAT_JSON && out->rows > 0)
+            rmbrl_out_write(out, ",", 1);
+        rmbrl_out_cstr(out, "{\"id\":");
+        rmbrl_out_int(out, id);
+        rmbrl_out_cstr(out, ",\"task\":");
+        rmbrl_out_json_str(out, task, task_size);
+        rmbrl_out_cstr(out, ",\"project\":");
+        rmbrl_out_json_str(out, project, project_size);
+        rmbrl_out_cstr(out, ",\"created_at\":");
+        rmbrl_out_write(out, "\"", 1);
+        rmbrl_out_write(out, timestamp, timestamp_len);
+        rmbrl_out_write(out, "\"", 1);
+        if (has_due)
+        {
+            rmbrl_out_cstr(out, ",\"due_at\":\"");
+            rmbrl_out_write(out, due, timestamp_len);
+            rmbrl_out_write(out, "\"", 1);
+        }
+        else if (out->due)
+        {
+            rmbrl_out_cstr(out, ",\"due_at\":null");
+        }
+        if (out->tags)
+        {
+            rmbrl_out_cstr(out, ",\"tags\":[");
+            for (int start = 0, i = 0; i <= tags_size && tags_size > 0; ++i)
+            {
+                if (i < tags_size && tags[i] != '\0')
+                    continue;
+                if (start > 0)
+                    rmbrl_out_write(out, ",", 1);
+                rmbrl_out_json_str(out, tags + start, i - start);
+                start = i + 1;
+            }
+            rmbrl_out_write(out, "]", 1);
+        }
+        if (out->store != NULL)
+        {
+            rmbrl_out_cstr(out, ",\"store\":");
+            rmbrl_out_json_str(out, (const unsigned char *)out->store, (int)strlen(out->store));
+        }
+        rmbrl_out_write(out, "}", 1);
+        if (out->format == RMBRL_FORMAT_NDJSON)
+            rmbrl_out_write(out, "\n", 1);
+        break;
+    case RMBRL_FORMAT_CSV:
+        if (out->rows == 0)
+        {
+            rmbrl_out_cstr(out, out->due ? "id,task,project,created_at,due_at"
+                                         : "id,task,project,created_at");
+            if (out->tags)
+                rmbrl_out_cstr(out, ",tags");
+            rmbrl_out_cstr(out, out->store != NULL ? ",store\r\n" : "\r\n");
+        }
+        rmbrl_out_int(out, id);
+        rmbrl_out_write(out, ",", 1);
+        rmbrl_out_csv_str(out, task, task_size);
+        rmbrl_out_write(out, ",", 1);
+        rmbrl_out_csv_str(out, project, project_size);
+        rmbrl_out_write(out, ",", 1);
+        rmbrl_out_write(out, timestamp, timestamp_len);
+        if (out->due)
+            rmbrl_out_write(out, ",", 1);
+        if (has_due)
+            rmbrl_out_write(out, due, timestamp_len);
+        if (out->tags)
+        {
+            rmbrl_out_write(out, ",", 1);
+            rmbrl_out_tags_joined(out, tags, tags_size);
+        }
+        if (out->store != NULL)
+        {
+            rmbrl_out_write(out, ",", 1);
+            rmbrl_out_csv_str(out, (const unsigned char *)out->store, (int)strlen(out->store));
+        }
+        rmbrl_out_write(out, "\r\n", 2);
+        break;
+    default:
+        RMBRL_UNREACHABLE("out memory format");
+    }
+
+    out->rows++;
+    rmbrl_stats_stop(&rmbrl_stats.output_ns, start);
+}
+
+// Writes the current row of a statement selecting RMBRL_MEMORY_COLUMNS, followed by due_at when
+// out->due is set and the tags when out->tags is.
+void rmbrl_out_memory(Rmbrl_Out *out, sqlite3_stmt *stmt)
+{
+    sqlite3_int64 id = sqlite3_column_int64(stmt, 0);
+    const unsigned char *task = sqlite3_column_text(stmt, 1);
+    int task_size = sqlite3_column_bytes(stmt, 1);
+    const unsigned char *project = sqlite3_column_text(stmt, 2);
+    int project_size = sqlite3_column_bytes(stmt, 2);
+    sqlite3_int64 created_at = sqlite3_column_int64(stmt, 3);
+    sqlite3_int64 due_at = out->due ? sqlite3_column_int64(stmt, 4) : 0;
+    int tags_column = out->due ? 5 : 4;
+    const unsigned char *tags = out->tags ? sqlite3_column_text(stmt, tags_column) : NULL;
+    int tags_size = out->tags ? sqlite3_column_bytes(stmt, tags_column) : 0;
+
+    rmbrl_out_memory_fields(out, id, task, task_size, project, project_size, created_at, due_at,
+                            tags, tags_size);
+}
+
+// Writes the current row of a statement selecting the name and count of a project.
+void rmbrl_out_project(Rmbrl_Out *out, sqlite3_stmt *stmt)
+{
+    const unsigned char *name = sqlite3_column_text(stmt, 0);
+    int name_size = sqlite3_column_bytes(stmt, 0);
+    sqlite3_int64 count = sqlite3_column_int64(stmt, 1);
+    sqlite3_int64 start = rmbrl_stats_start();
+
+    switch (out->format)
+    {
+    case RMBRL_FORMAT_TEXT:
+        rmbrl_out_cstr(out, "[INFO]     ");
+        if (name_size > 0)
+            rmbrl_out_write(out, (const char *)name, (size_t)name_size);
+        else
+            rmbrl_out_cstr(out, "(no project)");
+        rmbrl_out_write(out, " -- ", 4);
+        rmbrl_out_int(out, count);
+        rmbrl_out_write(out, "\n", 1);
+        break;
+    case RMBRL_FORMAT_TSV:
+        rmbrl_out_tsv_str(out, name, name_size);
+        rmbrl_out_write(out, "\t", 1);
+        rmbrl_out_int(out, count);
+        rmbrl_out_write(out, "\n", 1);
+        break;
+    case RMBRL_FORMAT_JSON:
+    case RMBRL_FORMAT_NDJSON:
+        if (out->format == RMBRL_FORMAT_JSON && out->rows > 0)
+            rmbrl_out_write(out, ",", 1);
+        rmbrl_out_cstr(out, "{\"project\":");
+        rmbrl_out_json_str(out, name, name_size);
+        rmbrl_out_cstr(out, ",\"count\":");
+        rmbrl_out_int(out, count);
+        rmbrl_out_write(out, "}", 1);
+        if (out->format == RMBRL_FORMAT_NDJSON)
+            rmbrl_out_write(out, "\n", 1);
+        break;
+    case RMBRL_FORMAT_CSV:
+        if (out->rows == 0)
+            rmbrl_out_cstr(out, "project,count\r\n");
+        rmbrl_out_csv_str(out, name, name_size);
+        rmbrl_out_write(out, ",", 1);
+        rmbrl_out_int(out, count);
+        rmbrl_out_write(out, "\r\n", 2);
+        break;
+    default:
+        RMBRL_UNREACHABLE("out project format");
+    }
+
+    out->rows++;
+    rmbrl_stats_stop(&rmbrl_stats.output_ns, start);
+}
+
+void rmbrl_out_end(Rmbrl_Out *out)
+{
+    sqlite3_int64 start = rmbrl_stats_start();
+    if (out->format == RMBRL_FORMAT_JSON)
+        rmbrl_out_write(out, "]\n", 2);
+
+    if (out->changed_only)
+    {
+        // an empty line still tells a reader that there is nothing to show anymore
+        if (!out->spilled && out->count == 0)
+            rmbrl_out_write(out, "\n", 1);
+        if (!out->spilled && rmbrl_out_last.valid && rmbrl_out_last.count == out->count &&
+            memcmp(rmbrl_out_last.buf, out->buf, out->count) == 0)
+        {
+            out->count = 0;
+        }
+        else
+        {
+            rmbrl_out_last.valid = !out->spilled;
+            rmbrl_out_last.count = out->count;
+            memcpy(rmbrl_out_last.buf, out->buf, out->count);
+        }
+    }
+    rmbrl_out_flush(out);
+    rmbrl_stats_stop(&rmbrl_stats.output_ns, start);
+}
+
+//
+// NOTES:
+//
+// Use sqlite3_exec when statement does not use user supplied input
+// Otherwise, manually prepare the statement to prevent SQL Injections.
+//
+// SQLITE_ENABLE_UPDATE_DELETE_LIMIT only works when SQLite is built from its canonical source, not
+// from the amalgamation we vendor. Therefore, we cannot use ORDER BY with DELETE or UPDATE.
+// Statements that delete the most recent items select their ids in a subquery instead.
+//
+
+// Every memory query selects the same columns in the same order, so the row printing code can
+// rely on the column indexes below. The project name is looked up by its primary key per row.
+#define RMBRL_MEMORY_COLUMNS                                                                       \
+    "id, task, (SELECT name FROM projects WHERE projects.id = project_id), created_at"
+
+// Current time in the unit of created_at and archived_at, milliseconds since the unix epoch
+#define RMBRL_SQL_NOW_MS "CAST(unixepoch('subsec') * 1000 AS INTEGER)"
+
+// Schema migrations
+//
+// Each entry upgrades the schema by exactly one version, PRAGMA user_version stores the number of
+// migrations applied so far. Never edit a migration that has been released, append a new one.
+static const char *rmbrl_migrations[] = {
+    // v1: initial schema, the IF NOT EXISTS keeps stores created before versioning working.
+    "CREATE TABLE IF NOT EXISTS memories("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,"
+    "task TEXT NOT NULL,"
+    "project TEXT DEFAULT '' NOT NULL,"
+    "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP NOT NULL);",
+
+    // v2: index-backed "most recent first" ordering, so peek and clear are index seeks instead of
+    // a full scan followed by a sort.
+    "CREATE INDEX IF NOT EXISTS memories_created_at ON memories(created_at, id);"
+    "CREATE INDEX IF NOT EXISTS memories_project_created_at ON memories(project, created_at, id);",
+
+    // v3: full-text index for search. External content keeps the task text stored once in memories,
+    // the triggers keep the index in sync and the rebuild indexes memories added before v3.
+    "CREATE VIRTUAL TABLE IF NOT EXISTS memories_fts USING fts5("
+    "task, content='memories', content_rowid='id');"
+    "CREATE TRIGGER IF NOT EXISTS memories_fts_insert AFTER INSERT ON memories BEGIN "
+    "INSERT INTO memories_fts(rowid, task) VALUES (new.id, new.task); END;"
+    "CREATE TRIGGER IF NOT EXISTS memories_fts_delete AFTER DELETE ON memories BEGIN "
+    "INSERT INTO memories_fts(memories_fts, rowid, task) VALUES ('delete', old.id, old.task); END;"
+    "CREATE TRIGGER IF NOT EXISTS memories_fts_update AFTER UPDATE OF task ON memories BEGIN "
+    "INSERT INTO memories_fts(memories_fts, rowid, task) VALUES ('delete', old.id, old.task);"
+    "INSERT INTO memories_fts(rowid, task) VALUES (new.id, new.task); END;"
+    "INSERT INTO memories_fts(memories_fts) VALUES ('rebuild');",
+
+    // v4: created_at holds milliseconds since the unix epoch instead of CURRENT_TIMESTAMP text, so
+    // ordering compares integers and adds within the same second keep their order. SQLite cannot
+    // change a column's type, the table is rebuilt with the same ids, which keeps memories_fts in
+    // sync. Dropping it drops its indexes and triggers, they are created again for the new table.
+    // The AUTOINCREMENT counter moves over, ids of cleared memories are not handed out again.
+    "CREATE TABLE memories_v4("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,"
+    "task TEXT NOT NULL,"
+    "project TEXT DEFAULT '' NOT NULL,"
+    "created_at INTEGER DEFAULT (CAST(unixepoch('subsec') * 1000 AS INTEGER)) NOT NULL);"
+    "INSERT INTO memories_v4(id, task, project, created_at) "
+    "SELECT id, task, project, COALESCE(unixepoch(created_at), 0) * 1000 FROM memories;"
+    "DELETE FROM sqlite_sequence WHERE name = 'memories_v4';"
+    "UPDATE sqlite_sequence SET name = 'memories_v4' WHERE name = 'memories';"
+    "DROP TABLE memories;"
+    "ALTER TABLE memories_v4 RENAME TO memories;"
+    "CREATE INDEX memories_created_at ON memories(created_at, id);"
+    "CREATE INDEX memories_project_created_at ON memories(project, created_at, id);"
+    "CREATE TRIGGER memories_fts_insert AFTER INSERT ON memories BEGIN "
+    "INSERT INTO memories_fts(rowid, task) VALUES (new.id, new.task); END;"
+    "CREATE TRIGGER memories_fts_delete AFTER DELETE ON memories BEGIN "
+    "INSERT INTO memories_fts(memories_fts, rowid, task) VALUES ('delete', old.id, old.task); END;"
+    "CREATE TRIGGER memories_fts_update AFTER UPDATE OF task ON memories BEGIN "
+    "INSERT INTO memories_fts(memories_fts, rowid, task) VALUES ('delete', old.id, old.task);"
+    "INSERT INTO memories_fts(rowid, task) VALUES (new.id, new.task); END;",
+
+    // v5: project names are interned into projects, memories only store the integer id, which is
+    // what project filters and the index compare. count and latest_id are maintained by triggers,
+    // so `rmbrl projects` and the latest memory of a project never scan memories. Projects stay
+    // interned when their last memory is cleared, they are listed once they have memories again.
+    "CREATE TABLE projects("
+    "id INTEGER PRIMARY KEY NOT NULL,"
+    "name TEXT UNIQUE NOT NULL,"
+    "count INTEGER DEFAULT 0 NOT NULL,"
+    "latest_id INTEGER);"
+    "INSERT INTO projects(name) SELECT DISTINCT project FROM memories ORDER BY project;"
+    "CREATE TABLE memories_v5("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,"
+    "task TEXT NOT NULL,"
+    "project_id INTEGER NOT NULL REFERENCES projects(id),"
+    "created_at INTEGER DEFAULT (CAST(unixepoch('subsec') * 1000 AS INTEGER)) NOT NULL);"
+    "INSERT INTO memories_v5(id, task, project_id, created_at) "
+    "SELECT m.id, m.task, p.id, m.created_at FROM memories m JOIN projects p ON p.name = m.project;"
+    "DELETE FROM sqlite_sequence WHERE name = 'memories_v5';"
+    "UPDATE sqlite_sequence SET name = 'memories_v5' WHERE name = 'memories';"
+    "DROP TABLE memories;"
+    "ALTER TABLE memories_v5 RENAME TO memories;"
+    "CREATE INDEX memories_created_at ON memories(created_at, id);"
+    "CREATE INDEX memories_project_created_at ON memories(project_id, created_at, id);"
+    "CREATE TRIGGER memories_fts_insert AFTER INSERT ON memories BEGIN "
+    "INSERT INTO memories_fts(rowid, task) VALUES (new.id, new.task); END;"
+    "CREATE TRIGGER memories_fts_delete AFTER DELETE ON memories BEGIN "
+    "INSERT INTO memories_fts(memories_fts, rowid, task) VALUES ('delete', old.id, old.task); END;"
+    "CREATE TRIGGER memories_fts_update AFTER UPDATE OF task ON memories BEGIN "
+    "INSERT INTO memories_fts(memories_fts, rowid, task) VALUES ('delete', old.id, old.task);"
+    "INSERT INTO memories_fts(rowid, task) VALUES (new.id, new.task); END;"
+    "UPDATE projects SET "
+    "count = (SELECT count(*) FROM memories WHERE project_id = projects.id),"
+    "latest_id = (SELECT id FROM memories WHERE project_id = projects.id "
+    "ORDER BY created_at DESC, id DESC LIMIT 1);"
+    // a new memory is usually the latest, the comparison only matters for older created_at values
+    "CREATE TRIGGER memories_projects_insert AFTER INSERT ON memories BEGIN "
+    "UPDATE projects SET count = count + 1, latest_id = CASE WHEN latest_id IS NULL OR "
+    "(new.created_at, new.id) > (SELECT created_at, id FROM memories WHERE id = latest_id) "
+    "THEN new.id ELSE latest_id END WHERE id = new.project_id; END;"
+    "CREATE TRIGGER memories_projects_delete AFTER DELETE ON memories BEGIN "
+    "UPDATE projects SET count = count - 1, latest_id = CASE WHEN latest_id = old.id THEN "
+    "(SELECT id FROM memories WHERE project_id = old.project_id "
+    "ORDER BY created_at DESC, id DESC LIMIT 1) ELSE latest_id END WHERE id = old.project_id; END;",
+
+    // v6: `clear --archive` keeps memories as history by setting archived_at instead of deleting
+    // them, `rmbrl gc` purges them later. The ordering indexes only cover live memories, so they do
+    // not grow with the history, archived_at gets its own index for gc. Project counts and latest
+    // ids only track live memories, purging an archived memory leaves them alone.
+    "ALTER TABLE memories ADD COLUMN archived_at INTEGER;"
+    "DROP INDEX memories_created_at;"
+    "DROP INDEX memories_project_created_at;"
+    "CREATE INDEX memories_created_at ON memories(created_at, id) WHERE archived_at IS NULL;"
+    "CREATE INDEX memories_project_created_at ON memories(project_id, created_at, id) "
+    "WHERE archived_at IS NULL;"
+    "CREATE INDEX memories_archived_at ON memories(archived_at) WHERE archived_at IS NOT NULL;"
+    "DROP TRIGGER memories_projects_delete;"
+    "CREATE TRIGGER memories_projects_delete AFTER DELETE ON memories "
+    "WHEN old.archived_at IS NULL BEGIN "
+    "UPDATE projects SET count = count - 1, latest_id = CASE WHEN latest_id = old.id THEN "
+    "(SELECT id FROM memories WHERE project_id = old.project_id AND archived_at IS NULL "
+    "ORDER BY created_at DESC, id DESC LIMIT 1) ELSE latest_id END WHERE id = old.project_id; END;"
+    "CREATE TRIGGER memories_projects_archive AFTER UPDATE OF archived_at ON memories "
+    "WHEN old.archived_at IS NULL AND new.archived_at IS NOT NULL BEGIN "
+    "UPDATE projects SET count = count - 1, latest_id = CASE WHEN latest_id = old.id THEN "
+    "(SELECT id FROM memories WHERE project_id = old.project_id AND archived_at IS NULL "
+    "ORDER BY created_at DESC, id DESC LIMIT 1) ELSE latest_id END WHERE id = old.project_id; END;",
+
+    // v7: how far the write log of `--backend log` has been folded into memories, see "Write log"
+    "CREATE TABLE wlog_state("
+    "id INTEGER PRIMARY KEY CHECK (id = 1),"
+    "generation INTEGER NOT NULL,"
+    "folded INTEGER NOT NULL);",
+
+    // v8: summaries for `rmbrl stats`, kept up to date by triggers like the project counts. Days
+    // are UTC days since the epoch, a memory counts as added on the day it was created and as
+    // cleared on the day it was deleted or archived. Deletes before v8 left no trace, only
+    // archived memories are counted as cleared for them.
+    "CREATE TABLE memory_totals("
+    "id INTEGER PRIMARY KEY CHECK (id = 1),"
+    "live INTEGER NOT NULL,"
+    "added INTEGER NOT NULL,"
+    "cleared INTEGER NOT NULL);"
+    "INSERT INTO memory_totals "
+    "SELECT 1, count(*) - count(archived_at), count(*), count(archived_at) FROM memories;"
+    "CREATE TABLE memory_days("
+    "day INTEGER PRIMARY KEY,"
+    "added INTEGER DEFAULT 0 NOT NULL,"
+    "cleared INTEGER DEFAULT 0 NOT NULL);"
+    "INSERT INTO memory_days (day, added) "
+    "SELECT created_at / 86400000, count(*) FROM memories GROUP BY 1;"
+    "INSERT INTO memory_days (day, cleared) "
+    "SELECT archived_at / 86400000, count(*) FROM memories WHERE archived_at IS NOT NULL "
+    "GROUP BY 1 ON CONFLICT (day) DO UPDATE SET cleared = excluded.cleared;"
+    "CREATE TRIGGER memories_stats_insert AFTER INSERT ON memories BEGIN "
+    "UPDATE memory_totals SET live = live + 1, added = added + 1;"
+    "INSERT INTO memory_days (day, added) VALUES (new.created_at / 86400000, 1) "
+    "ON CONFLICT (day) DO UPDATE SET added = added + 1; END;"
+    "CREATE TRIGGER memories_stats_delete AFTER DELETE ON memories "
+    "WHEN old.archived_at IS NULL BEGIN "
+    "UPDATE memory_totals SET live = live - 1, cleared = cleared + 1;"
+    "INSERT INTO memory_days (day, cleared) VALUES (unixepoch() / 86400, 1) "
+    "ON CONFLICT (day) DO UPDATE SET cleared = cleared + 1; END;"
+    "CREATE TRIGGER memories_stats_archive AFTER UPDATE OF archived_at ON memories "
+    "WHEN old.archived_at IS NULL AND new.archived_at IS NOT NULL BEGIN "
+    "UPDATE memory_totals SET live = live - 1, cleared = cleared + 1;"
+    "INSERT INTO memory_days (day, cleared) VALUES (new.archived_at / 86400000, 1) "
+    "ON CONFLICT (day) DO UPDATE SET cleared = cleared + 1; END;",
+
+    // v9: `add --due` sets due_at, `rmbrl due` and `peek --by-due` walk these soonest first. Like
+    // the ordering indexes they only cover live memories, and only the ones with a due date, so
+    // memories without one cost nothing.
+    "ALTER TABLE memories ADD COLUMN due_at INTEGER;"
+    "CREATE INDEX memories_due_at ON memories(due_at, id) "
+    "WHERE due_at IS NOT NULL AND archived_at IS NULL;"
+    "CREATE INDEX memories_project_due_at ON memories(project_id, due_at, id) "
+    "WHERE due_at IS NOT NULL AND archived_at IS NULL;",
+
+    // v10: tags, a memory has any number of them. Like project names they are interned, memory_tags
+    // is clustered by (tag_id, memory_id) so the memories of a tag are one range of the table and
+    // checking whether a memory has a tag is a single lookup, memory_tags_memory_id finds the tags
+    // of a memory when it is deleted. count is maintained by triggers, it is how many memories have
+    // the tag, archived ones included, and tells queries which tag is the rarest.
+    "CREATE TABLE tags("
+    "id INTEGER PRIMARY KEY NOT NULL,"
+    "name TEXT UNIQUE NOT NULL,"
+    "count INTEGER DEFAULT 0 NOT NULL);"
+    "CREATE TABLE memory_tags("
+    "tag_id INTEGER NOT NULL REFERENCES tags(id),"
+    "memory_id INTEGER NOT NULL REFERENCES memories(id),"
+    "PRIMARY KEY (tag_id, memory_id)) WITHOUT ROWID;"
+    "CREATE INDEX memory_tags_memory_id ON memory_tags(memory_id);"
+    "CREATE TRIGGER memory_tags_insert AFTER INSERT ON memory_tags BEGIN "
+    "UPDATE tags SET count = count + 1 WHERE id = new.tag_id; END;"
+    "CREATE TRIGGER memory_tags_delete AFTER DELETE ON memory_tags BEGIN "
+    "UPDATE tags SET count = count - 1 WHERE id = old.tag_id; END;"
+    "CREATE TRIGGER memories_tags_delete AFTER DELETE ON memories BEGIN "
+    "DELETE FROM memory_tags WHERE memory_id = old.id; END;",
+};
+
+#define RMBRL_SCHEMA_VERSION ((int)(sizeof(rmbrl_migrations) / sizeof(rmbrl_migrations[0])))
+
+int rmbrl_db_get_user_version(sqlite3 *db, int *version)
+{
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    int result = sqlite3_step(stmt);
+    if (result == SQLITE_ROW)
+        *version = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_ROW)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read schema version: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    return 0;
+}
+
+int rmbrl_db_migrate(sqlite3 *db, Rmbrl_Verbosity_Level verbosity)
+{
+    // Fast path, reading user_version only touches the database header.
+    int version = 0;
+    if (rmbrl_db_get_user_version(db, &version) != 0)
+        return 1;
+
+    if (version == RMBRL_SCHEMA_VERSION)
+    {
+        if (verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "Schema is up to date (v%d)\n", version);
+        return 0;
+    }
+
+    if (version > RMBRL_SCHEMA_VERSION)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR,
+                  "Database schema v%d is newer than this remembrall supports (v%d). "
+                  "Please upgrade remembrall.\n",
+                  version, RMBRL_SCHEMA_VERSION);
+        return 1;
+    }
+
+    char *err_msg;
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, 0, &err_msg) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to begin migration: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return 1;
+    }
+
+    // Another invocation may have migrated the store while we were waiting for the write lock.
+    int result = rmbrl_db_get_user_version(db, &version);
+    for (; result == 0 && version < RMBRL_SCHEMA_VERSION; ++version)
+    {
+        if (verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "Migrating schema to v%d...\n", version + 1);
+
+        if (sqlite3_exec(db, rmbrl_migrations[version], NULL, 0, &err_msg) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to migrate schema to v%d: %s\n", version + 1,
+                      err_msg);
+            sqlite3_free(err_msg);
+            result = 1;
+        }
+    }
+
+    if (result == 0)
+    {
+        // PRAGMA does not support bound parameters, the version is ours and not user supplied.
+        char statement[64];
+        snprintf(statement, sizeof(statement), "PRAGMA user_version = %d; COMMIT;",
+                 RMBRL_SCHEMA_VERSION);
+        if (sqlite3_exec(db, statement, NULL, 0, &err_msg) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to commit migration: %s\n", err_msg);
+            sqlite3_free(err_msg);
+            result = 1;
+        }
+    }
+
+    if (result != 0)
+    {
+        sqlite3_exec(db, "ROLLBACK;", NULL, 0, NULL);
+        return result;
+    }
+
+    if (verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "Schema migrated to v%d\n", RMBRL_SCHEMA_VERSION);
+
+    return 0;
+}
+
+// `rmbrl exec` runs every command of a script inside of its own transaction. Commands then begin,
+// commit and roll back a savepoint instead, so a failing command still only undoes its own
+// changes before the script rolls back as a whole.
+static struct
+{
+    bool active;
+    size_t line; // of the command being run
+} rmbrl_script;
+
+int rmbrl_db_begin_transaction(sqlite3 *db, Rmbrl_Verbosity_Level verbosity)
+{
+    char *err_msg;
+    // IMMEDIATE takes the write lock up front, a deferred transaction that reads first and then
+    // writes fails with SQLITE_BUSY_SNAPSHOT instead of waiting when another invocation committed.
+    const char *begin = rmbrl_script.active ? "SAVEPOINT rmbrl_command;" : "BEGIN IMMEDIATE;";
+    if (sqlite3_exec(db, begin, NULL, 0, &err_msg) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to begin transaction: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return 1;
+    }
+
+    if (verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "Begin transaction...\n");
+
+    return 0;
+}
+
+int rmbrl_db_rollback_transaction(sqlite3 *db, Rmbrl_Verbosity_Level verbosity)
+{
+    char *err_msg;
+    const char *rollback = rmbrl_script.active
+                               ? "ROLLBACK TO rmbrl_command; RELEASE rmbrl_command;"
+                               : "ROLLBACK;";
+    if (sqlite3_exec(db, rollback, NULL, 0, &err_msg) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to rollback transaction: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return 1;
+    }
+
+    if (verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "Rollback transaction...\n");
+
+    return 0;
+}
+
+int rmbrl_db_commit_transaction(sqlite3 *db, Rmbrl_Verbosity_Level verbosity)
+{
+    char *err_msg;
+    const char *commit = rmbrl_script.active ? "RELEASE rmbrl_command;" : "COMMIT;";
+    if (sqlite3_exec(db, commit, NULL, 0, &err_msg) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to commit transaction: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return 1;
+    }
+
+    if (verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "Commit transaction...\n");
+
+    return 0;
+}
+
+// Latency budget
+//
+// --timeout-ms bounds how long one invocation may take, so a prompt running `rmbrl peek` on a
+// locked, slow or huge store gets its answer or gives up within the budget. The budget starts with
+// the invocation: waits for locks end with it and a progress handler interrupts statements that
+// are still running past it. An invocation that ran out of budget does not log the errors of what
+// was interrupted and exits with RMBRL_EXIT_TIMEOUT.
+
+#ifndef RMBRL_PROGRESS_OPS
+#define RMBRL_PROGRESS_OPS 1000
+#endif
+
+typedef struct
+{
+    sqlite3_int64 deadline_ns; // 0 without a budget
+    bool expired;
+} Rmbrl_Budget;
+
+static Rmbrl_Budget rmbrl_budget;
+
+// The deadline of the client whose request `rmbrl serve` is running, 0 if it has none. The
+// monotonic clock is the same for every process, so it bounds the request on the server as well.
+static sqlite3_int64 rmbrl_budget_client_deadline_ns;
+
+// Starts the budget of the running invocation, timeout_ms 0 means it has none.
+void rmbrl_budget_begin(int timeout_ms)
+{
+    rmbrl_budget = (Rmbrl_Budget){0};
+    rmbrl_log_quiet = false;
+    if (timeout_ms > 0)
+        rmbrl_budget.deadline_ns = rmbrl_stats.start_ns + (sqlite3_int64)timeout_ms * 1000000;
+    sqlite3_int64 client_ns = rmbrl_budget_client_deadline_ns;
+    if (client_ns != 0 && (rmbrl_budget.deadline_ns == 0 || client_ns < rmbrl_budget.deadline_ns))
+        rmbrl_budget.deadline_ns = client_ns;
+}
+
+// Returns the milliseconds left of the budget, INT_MAX without one. Once none are left the budget
+// is expired.
+int rmbrl_budget_remaining_ms(void)
+{
+    if (rmbrl_budget.deadline_ns == 0)
+        return INT_MAX;
+
+    sqlite3_int64 remaining_ns = rmbrl_budget.deadline_ns - rmbrl_stats_now_ns();
+    if (remaining_ns <= 0)
+    {
+        rmbrl_budget.expired = true;
+        rmbrl_log_quiet = true;
+        return 0;
+    }
+    return (int)((remaining_ns + 999999) / 1000000);
+}
+
+int rmbrl_db_progress_handler(void *ctx)
+{
+    (void)ctx;
+    return rmbrl_budget_remaining_ms() == 0;
+}
+
+// Interrupts the statements of db once the budget runs out. `rmbrl serve` calls it again for every
+// invocation it runs on its connection, also to remove the handler of the previous one.
+void rmbrl_db_set_budget(sqlite3 *db)
+{
+    if (rmbrl_budget.deadline_ns == 0)
+        sqlite3_progress_handler(db, 0, NULL, NULL);
+    else
+        sqlite3_progress_handler(db, RMBRL_PROGRESS_OPS, rmbrl_db_progress_handler, NULL);
+}
+
+// Busy handling
+//
+// sqlite3_busy_timeout backs off in fixed steps, this handler doubles the sleep from 1ms up to
+// RMBRL_BUSY_MAX_SLEEP_MS so short collisions between hooks and prompts resolve within a
+// millisecond or two, while long waits do not spin. Gives up once timeout_ms has been spent
+// waiting for the same lock, or earlier when the latency budget runs out.
+
+typedef struct
+{
+    int timeout_ms;
+    int waited_ms;
+} Rmbrl_Busy;
+
+static Rmbrl_Busy rmbrl_busy;
+
+int rmbrl_db_busy_handler(void *ctx, int count)
+{
+    Rmbrl_Busy *busy = ctx;
+    if (count == 0)
+        busy->waited_ms = 0;
+
+    int remaining_ms = busy->timeout_ms - busy->waited_ms;
+    int budget_ms = rmbrl_budget_remaining_ms();
+    if (budget_ms < remaining_ms)
+        remaining_ms = budget_ms;
+    if (remaining_ms <= 0)
+        return 0;
+
+    int sleep_ms = count < 6 ? 1 << count : RMBRL_BUSY_MAX_SLEEP_MS;
+    if (sleep_ms > RMBRL_BUSY_MAX_SLEEP_MS)
+        sleep_ms = RMBRL_BUSY_MAX_SLEEP_MS;
+    if (sleep_ms > remaining_ms)
+        sleep_ms = remaining_ms;
+
+    sqlite3_sleep(sleep_ms);
+    busy->waited_ms += sleep_ms;
+    return 1;
+}
+
+// Statement cache
+//
+// Every statement is prepared once per connection and kept for reuse, `rmbrl serve` then skips
+// parsing and planning for every request after the first. Statements are looked up by their SQL,
+// callers hand them back with rmbrl_db_release instead of finalizing them.
+
+#ifndef RMBRL_STMT_CACHE_CAP
+#define RMBRL_STMT_CACHE_CAP 32
+#endif
+
+static sqlite3_stmt *rmbrl_stmt_cache[RMBRL_STMT_CACHE_CAP];
+static size_t rmbrl_stmt_cache_next;
+
+int rmbrl_db_prepare(sqlite3 *db, const char *raw_stmt, sqlite3_stmt **stmt)
+{
+    for (size_t i = 0; i < RMBRL_STMT_CACHE_CAP; ++i)
+    {
+        sqlite3_stmt *cached = rmbrl_stmt_cache[i];
+        if (cached != NULL && sqlite3_db_handle(cached) == db &&
+            strcmp(sqlite3_sql(cached), raw_stmt) == 0)
+        {
+            *stmt = cached;
+            return SQLITE_OK;
+        }
+    }
+
+    sqlite3_int64 start = rmbrl_stats_start();
+    int result = sqlite3_prepare_v3(db, raw_stmt, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL);
+    rmbrl_stats_stop(&rmbrl_stats.prepare_ns, start);
+    if (result != SQLITE_OK)
+        return result;
+    rmbrl_stats.prepared++;
+
+    // once full, the oldest statement makes room
+    size_t slot = rmbrl_stmt_cache_next++ % RMBRL_STMT_CACHE_CAP;
+    sqlite3_finalize(rmbrl_stmt_cache[slot]);
+    rmbrl_stmt_cache[slot] = *stmt;
+    return SQLITE_OK;
+}
+
+// Resets a statement from rmbrl_db_prepare for its next use, it ends any read the statement holds.
+void rmbrl_db_release(sqlite3_stmt *stmt)
+{
+    if (rmbrl_stats.enabled)
+        rmbrl_stats_statement(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+void rmbrl_db_finalize_cached(void)
+{
+    for (size_t i = 0; i < RMBRL_STMT_CACHE_CAP; ++i)
+    {
+        sqlite3_finalize(rmbrl_stmt_cache[i]);
+        rmbrl_stmt_cache[i] = NULL;
+    }
+    rmbrl_stmt_cache_next = 0;
+}
+
+// Every process starts by replaying the WAL, so it has to stay small for peeks to stay fast.
+// Once it grows past RMBRL_WAL_TRUNCATE_SIZE, e.g. every few dozen adds or after a bulk import,
+// the invocation that wrote last checkpoints it into the database and truncates it. When readers
+// or another writer are busy with the store the checkpoint is skipped, the next writer tries again.
+//
+void rmbrl_db_truncate_wal(sqlite3 *db)
+{
+    const char *db_filename = sqlite3_db_filename(db, "main");
+    if (db_filename == NULL || *db_filename == '\0' || sqlite3_total_changes(db) == 0)
+        return;
+
+    const char *wal_filename = sqlite3_filename_wal(db_filename);
+    struct stat wal_stat;
+    if (stat(wal_filename, &wal_stat) == 0 && wal_stat.st_size > RMBRL_WAL_TRUNCATE_SIZE)
+    {
+        sqlite3_busy_handler(db, NULL, NULL);
+        sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL);
+        sqlite3_busy_handler(db, rmbrl_db_busy_handler, &rmbrl_busy);
+    }
+}
+
+// Prompt snapshot
+//
+// Prompts run `peek -s -p project` on every render. `peek --cached` serves that from a small fixed
+// layout file next to the database ("rmbrl.db-snap") without opening SQLite at all. It holds the
+// most recent memory overall and of up to RMBRL_SNAPSHOT_SLOTS projects.
+//
+// Commands that change memories rewrite it after they committed, along with the size and
+// modification time of the database and its WAL at that point. Every commit changes at least one
+// of them, so a reader that finds a different signature knows the snapshot is stale and falls back
+// to the database. The writer compares PRAGMA data_version from inside of its transaction with
+// the one after taking the signature, if another connection committed in between the snapshot
+// would not match the signature and is not written.
+//
+// Slots are refreshed incrementally, a write only queries the latest memory overall and of the
+// project it changed. Without a valid previous snapshot it starts over with just those two.
+
+#ifndef RMBRL_SNAPSHOT_SLOTS
+#define RMBRL_SNAPSHOT_SLOTS 64
+#endif
+
+#define RMBRL_SNAPSHOT_MAGIC "RMBRLSNP"
+
+typedef struct
+{
+    sqlite3_int64 db_size;
+    sqlite3_int64 db_mtime_ns;
+    sqlite3_int64 wal_size; // -1 without a WAL
+    sqlite3_int64 wal_mtime_ns;
+} Rmbrl_Snapshot_Sig;
+
+typedef struct
+{
+    sqlite3_int64 id;         // 0 when there is no memory
+    sqlite3_int64 generation; // snapshot generation the slot was last refreshed in
+    sqlite3_int64 created_at;
+    int task_size;
+    int project_size;
+    char task[256 + 1];
+    char project[256 + 1];
+} Rmbrl_Snapshot_Slot;
+
+typedef struct
+{
+    char magic[8];
+    unsigned int size;        // sizeof(Rmbrl_Snapshot), tells apart layouts of other builds
+    unsigned int complete;    // every project with memories has a slot
+    sqlite3_int64 generation; // incremented by every rewrite
+    Rmbrl_Snapshot_Sig sig;
+    Rmbrl_Snapshot_Slot latest;
+    unsigned int slot_count;
+    Rmbrl_Snapshot_Slot slots[RMBRL_SNAPSHOT_SLOTS];
+} Rmbrl_Snapshot;
+
+sqlite3_int64 rmbrl_stat_mtime_ns(const struct stat *st)
+{
+#if defined(_WIN32)
+    return (sqlite3_int64)st->st_mtime * 1000000000;
+#elif defined(__APPLE__) && defined(__MACH__)
+    return (sqlite3_int64)st->st_mtimespec.tv_sec * 1000000000 + st->st_mtimespec.tv_nsec;
+#else
+    return (sqlite3_int64)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#endif
+}
+
+// Returns false if the database at db_path does not exist.
+bool rmbrl_snapshot_sig(const char *db_path, Rmbrl_Snapshot_Sig *sig)
+{
+    struct stat st;
+    if (stat(db_path, &st) != 0)
+        return false;
+    sig->db_size = st.st_size;
+    sig->db_mtime_ns = rmbrl_stat_mtime_ns(&st);
+
+    char wal_path[1024];
+    if (snprintf(wal_path, sizeof(wal_path), "%s-wal", db_path) >= (int)sizeof(wal_path))
+        return false;
+    if (stat(wal_path, &st) == 0)
+    {
+        sig->wal_size = st.st_size;
+        sig->wal_mtime_ns = rmbrl_stat_mtime_ns(&st);
+    }
+    else
+    {
+        sig->wal_size = -1;
+        sig->wal_mtime_ns = 0;
+    }
+    return true;
+}
+
+bool rmbrl_snapshot_is_current(const Rmbrl_Snapshot *snap, const Rmbrl_Snapshot_Sig *sig)
+{
+    return memcmp(snap->magic, RMBRL_SNAPSHOT_MAGIC, sizeof(snap->magic)) == 0 &&
+           snap->size == sizeof(Rmbrl_Snapshot) && snap->slot_count <= RMBRL_SNAPSHOT_SLOTS &&
+           memcmp(&snap->sig, sig, sizeof(*sig)) == 0;
+}
+
+// Returns the slot of project, or of the latest memory overall when project is NULL. NULL if the
+// snapshot has no slot for project.
+const Rmbrl_Snapshot_Slot *rmbrl_snapshot_find(const Rmbrl_Snapshot *snap, const char *project)
+{
+    if (project == NULL)
+        return &snap->latest;
+
+    size_t project_size = strlen(project);
+    for (unsigned int i = 0; i < snap->slot_count; ++i)
+    {
+        const Rmbrl_Snapshot_Slot *slot = &snap->slots[i];
+        if ((size_t)slot->project_size == project_size &&
+            memcmp(slot->project, project, project_size) == 0)
+            return slot;
+    }
+    return NULL;
+}
+
+// Maps the snapshot file read-only. Returns NULL if it is missing or has an unexpected size.
+const Rmbrl_Snapshot *rmbrl_snapshot_map(const char *snap_path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(snap_path, GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart == (LONGLONG)sizeof(Rmbrl_Snapshot))
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return NULL;
+
+    // the view keeps the mapping alive
+    const Rmbrl_Snapshot *snap = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(*snap));
+    CloseHandle(mapping);
+    return snap;
+#else
+    int fd = open(snap_path, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size == (off_t)sizeof(Rmbrl_Snapshot))
+        addr = mmap(NULL, sizeof(Rmbrl_Snapshot), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return addr == MAP_FAILED ? NULL : addr;
+#endif // end _WIN32
+}
+
+void rmbrl_snapshot_unmap(const Rmbrl_Snapshot *snap)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(snap);
+#else
+    munmap((void *)snap, sizeof(*snap));
+#endif // end _WIN32
+}
+
+// Runs a statement that returns a single integer, e.g. a PRAGMA.
+bool rmbrl_db_query_int(sqlite3 *db, const char *raw_stmt, int *value)
+{
+    sqlite3_stmt *stmt;
+    if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+        return false;
+
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found)
+        *value = sqlite3_column_int(stmt, 0);
+    rmbrl_db_release(stmt);
+    return found;
+}
+
+typedef struct
+{
+    bool active; // rmbrl_snapshot_begin succeeded, rmbrl_snapshot_commit will write the snapshot
+    int data_version;
+    const char *db_filename;
+    Rmbrl_Snapshot snap;
+} Rmbrl_Snapshot_Writer;
+
+static Rmbrl_Snapshot_Writer rmbrl_snapshot_writer;
+
+// Loads the previous snapshot if it is still current. Called inside of the transaction of a
+// command, before it changes anything.
+void rmbrl_snapshot_begin(sqlite3 *db)
+{
+    Rmbrl_Snapshot_Writer *writer = &rmbrl_snapshot_writer;
+    writer->active = false;
+
+    // commands of a script commit before the script does, which may still roll them back. The
+    // script's commit changes the signature and peeks read the store until the next write.
+    if (rmbrl_script.active)
+        return;
+
+    // stores without a file, e.g. ":memory:", have nowhere to put a snapshot
+    writer->db_filename = sqlite3_db_filename(db, "main");
+    if (writer->db_filename == NULL || *writer->db_filename == '\0')
+        return;
+
+    Rmbrl_Snapshot_Sig sig;
+    if (!rmbrl_db_query_int(db, "PRAGMA data_version;", &writer->data_version) ||
+        !rmbrl_snapshot_sig(writer->db_filename, &sig))
+        return;
+
+    char snap_path[1024];
+    if (snprintf(snap_path, sizeof(snap_path), "%s-snap", writer->db_filename) >=
+        (int)sizeof(snap_path))
+        return;
+
+    bool current = false;
+    FILE *file = fopen(snap_path, "rb");
+    if (file != NULL)
+    {
+        current = fread(&writer->snap, sizeof(writer->snap), 1, file) == 1 &&
+                  rmbrl_snapshot_is_current(&writer->snap, &sig);
+        fclose(file);
+    }
+
+    if (!current)
+    {
+        memset(&writer->snap, 0, sizeof(writer->snap));
+
+        // without memories there are no projects, so the empty snapshot knows about all of them
+        int empty;
+        if (rmbrl_db_query_int(
+                db, "SELECT NOT EXISTS (SELECT 1 FROM memories WHERE archived_at IS NULL);",
+                &empty))
+            writer->snap.complete = empty;
+    }
+
+    writer->active = true;
+}
+
+// Returns false if the memory does not fit into a slot.
+bool rmbrl_snapshot_query_slot(sqlite3 *db, const char *project, Rmbrl_Snapshot_Slot *slot)
+{
+    const char *raw_stmt = project ? "SELECT " RMBRL_MEMORY_COLUMNS " FROM memories WHERE id = "
+                                     "(SELECT latest_id FROM projects WHERE name = ?);"
+                                   : "SELECT " RMBRL_MEMORY_COLUMNS " FROM memories "
+                                     "WHERE archived_at IS NULL "
+                                     "ORDER BY created_at DESC, id DESC LIMIT 1;";
+
+    sqlite3_stmt *stmt;
+    if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+        return false;
+    if (project)
+        sqlite3_bind_text(stmt, 1, project, -1, SQLITE_STATIC);
+
+    memset(slot, 0, sizeof(*slot));
+    int result = sqlite3_step(stmt);
+    if (result == SQLITE_ROW)
+    {
+        slot->id = sqlite3_column_int64(stmt, 0);
+        slot->task_size = sqlite3_column_bytes(stmt, 1);
+        slot->project_size = sqlite3_column_bytes(stmt, 2);
+        slot->created_at = sqlite3_column_int64(stmt, 3);
+        if ((size_t)slot->task_size >= sizeof(slot->task) ||
+            (size_t)slot->project_size >= sizeof(slot->project))
+            result = SQLITE_TOOBIG;
+        else
+        {
+            memcpy(slot->task, sqlite3_column_text(stmt, 1), (size_t)slot->task_size);
+            memcpy(slot->project, sqlite3_column_text(stmt, 2), (size_t)slot->project_size);
+            result = SQLITE_DONE;
+        }
+    }
+    else if (result == SQLITE_DONE && project)
+    {
+        // a project without memories is cached as well, it prints nothing
+        slot->project_size = (int)strlen(project);
+        memcpy(slot->project, project, (size_t)slot->project_size);
+    }
+    rmbrl_db_release(stmt);
+
+    return result == SQLITE_DONE;
+}
+
+// Queries the latest memory overall and, unless it is NULL, the latest of project. Called inside
+// of the transaction after its changes, so the slots match what it commits.
+void rmbrl_snapshot_refresh(sqlite3 *db, const char *project)
+{
+    Rmbrl_Snapshot_Writer *writer = &rmbrl_snapshot_writer;
+    if (!writer->active)
+        return;
+
+    sqlite3_int64 generation = writer->snap.generation + 1;
+    if (!rmbrl_snapshot_query_slot(db, NULL, &writer->snap.latest))
+    {
+        writer->active = false;
+        return;
+    }
+    writer->snap.latest.generation = generation;
+
+    if (project == NULL || strlen(project) >= sizeof(writer->snap.latest.project))
+        return;
+
+    Rmbrl_Snapshot_Slot *slot = (Rmbrl_Snapshot_Slot *)rmbrl_snapshot_find(&writer->snap, project);
+    if (slot == NULL && writer->snap.slot_count < RMBRL_SNAPSHOT_SLOTS)
+    {
+        slot = &writer->snap.slots[writer->snap.slot_count++];
+    }
+    else if (slot == NULL)
+    {
+        // evict the least recently refreshed project, it is no longer known to be empty
+        slot = &writer->snap.slots[0];
+        for (unsigned int i = 1; i < writer->snap.slot_count; ++i)
+            if (writer->snap.slots[i].generation < slot->generation)
+                slot = &writer->snap.slots[i];
+        writer->snap.complete = false;
+    }
+
+    if (!rmbrl_snapshot_query_slot(db, project, slot))
+    {
+        writer->active = false;
+        return;
+    }
+    slot->generation = generation;
+}
+
+// The transaction may have changed any project, refreshes the latest memory and every slot. If it
+// added memories, projects without a slot may have some now and the snapshot is no longer complete.
+void rmbrl_snapshot_refresh_all(sqlite3 *db, bool added)
+{
+    Rmbrl_Snapshot_Writer *writer = &rmbrl_snapshot_writer;
+    rmbrl_snapshot_refresh(db, NULL);
+    if (!writer->active)
+        return;
+    if (added)
+        writer->snap.complete = false;
+
+    for (unsigned int i = 0; i < writer->snap.slot_count; ++i)
+    {
+        // querying the slot clears it, the project name has to outlive that
+        Rmbrl_Snapshot_Slot *slot = &writer->snap.slots[i];
+        char project[sizeof(slot->project)];
+        memcpy(project, slot->project, sizeof(project));
+        if (!rmbrl_snapshot_query_slot(db, project, slot))
+        {
+            writer->active = false;
+            return;
+        }
+        slot->generation = writer->snap.latest.generation;
+    }
+}
+
+// Every memory is gone, which also makes every project known to be empty.
+void rmbrl_snapshot_forget_all(void)
+{
+    Rmbrl_Snapshot *snap = &rmbrl_snapshot_writer.snap;
+    memset(&snap->latest, 0, sizeof(snap->latest));
+    memset(snap->slots, 0, sizeof(snap->slots));
+    snap->slot_count = 0;
+    snap->complete = true;
+}
+
+// Drops what rmbrl_snapshot_begin loaded, the transaction is rolled back instead of committed.
+void rmbrl_snapshot_abort(void)
+{
+    rmbrl_snapshot_writer.active = false;
+}
+
+// Writes the snapshot once the transaction committed. It is written to a temporary file first
+// and renamed over the previous one, so readers only ever map a complete snapshot.
+void rmbrl_snapshot_commit(sqlite3 *db)
+{
+    Rmbrl_Snapshot_Writer *writer = &rmbrl_snapshot_writer;
+    if (!writer->active)
+        return;
+    writer->active = false;
+
+    // truncating the WAL changes the signature, it has to happen before it is taken
+    rmbrl_db_truncate_wal(db);
+
+    Rmbrl_Snapshot *snap = &writer->snap;
+    int data_version;
+    if (!rmbrl_snapshot_sig(writer->db_filename, &snap->sig) ||
+        !rmbrl_db_query_int(db, "PRAGMA data_version;", &data_version) ||
+        data_version != writer->data_version)
+        return;
+
+    memcpy(snap->magic, RMBRL_SNAPSHOT_MAGIC, sizeof(snap->magic));
+    snap->size = sizeof(Rmbrl_Snapshot);
+    snap->generation++;
+
+    char snap_path[1024];
+    char tmp_path[1024 + 32];
+    if (snprintf(snap_path, sizeof(snap_path), "%s-snap", writer->db_filename) >=
+        (int)sizeof(snap_path))
+        return;
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", snap_path, (long)getpid());
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL)
+        return;
+    bool written = fwrite(snap, sizeof(*snap), 1, file) == 1;
+    written = fclose(file) == 0 && written;
+
+#ifdef _WIN32
+    if (!written || !MoveFileExA(tmp_path, snap_path, MOVEFILE_REPLACE_EXISTING))
+        remove(tmp_path);
+#else
+    if (!written || rename(tmp_path, snap_path) != 0)
+        remove(tmp_path);
+#endif // end _WIN32
+}
+
+// Reads the next delim terminated record from stream into buf, without the delimiter.
+// Returns the record length, or -1 once stream is exhausted. Records that do not fit into buf are
+// still consumed in full, the return value is then buf_size so callers can reject them.
+long rmbrl_read_record(FILE *stream, char delim, char *buf, size_t buf_size)
+{
+    size_t len = 0;
+    bool overflow = false;
+    int c;
+    while ((c = getc(stream)) != EOF && c != delim)
+    {
+        if (len + 1 < buf_size)
+            buf[len++] = (char)c;
+        else
+            overflow = true;
+    }
+
+    if (c == EOF && len == 0 && !overflow)
+        return -1;
+
+    buf[len] = '\0';
+    return overflow ? (long)buf_size : (long)len;
+}
+
+// Looks up the id of the project named name, adding it to projects the first time it is used.
+int rmbrl_db_intern_project(sqlite3 *db, const char *name, sqlite3_int64 *id)
+{
+    sqlite3_stmt *stmt;
+    if (rmbrl_db_prepare(db, "SELECT id FROM projects WHERE name = ?;", &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    int result = sqlite3_step(stmt);
+    if (result == SQLITE_ROW)
+        *id = sqlite3_column_int64(stmt, 0);
+    rmbrl_db_release(stmt);
+
+    if (result == SQLITE_DONE)
+    {
+        if (rmbrl_db_prepare(db, "INSERT INTO projects(name) VALUES (?);", &stmt) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+            return 1;
+        }
+        sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+        result = sqlite3_step(stmt);
+        *id = sqlite3_last_insert_rowid(db);
+        rmbrl_db_release(stmt);
+    }
+    else if (result == SQLITE_ROW)
+    {
+        result = SQLITE_DONE;
+    }
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember project: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    return 0;
+}
+
+// Tags
+//
+// `-t bug -t p1` tags a memory with add and requires every tag with peek and due. A filter on
+// several tags is an intersection that starts from the rarest one: the memory_tags range of that
+// tag drives the query and every other tag is one primary key lookup per candidate, so the work is
+// bounded by the rarest tag instead of the store or the product of the tags.
+
+typedef struct
+{
+    sqlite3_int64 id;
+    sqlite3_int64 count;
+} Rmbrl_Tag;
+
+bool rmbrl_tags_check(Rmbrl_Command *cmd)
+{
+    for (size_t i = 0; i < cmd->tags_count; ++i)
+    {
+        if (strlen(cmd->tags[i]) > 256)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Tag \"%s\" exceeds char limit of 256 bytes.\n",
+                      cmd->tags[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Interns the count tags of names into ids like rmbrl_db_intern_project.
+int rmbrl_db_intern_tags(sqlite3 *db, char *const *names, size_t count, sqlite3_int64 *ids)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        sqlite3_stmt *stmt;
+        if (rmbrl_db_prepare(db, "SELECT id FROM tags WHERE name = ?;", &stmt) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+            return 1;
+        }
+        sqlite3_bind_text(stmt, 1, names[i], -1, SQLITE_STATIC);
+        int result = sqlite3_step(stmt);
+        if (result == SQLITE_ROW)
+            ids[i] = sqlite3_column_int64(stmt, 0);
+        rmbrl_db_release(stmt);
+
+        if (result == SQLITE_DONE)
+        {
+            if (rmbrl_db_prepare(db, "INSERT INTO tags(name) VALUES (?);", &stmt) != SQLITE_OK)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n",
+                          sqlite3_errmsg(db));
+                return 1;
+            }
+            sqlite3_bind_text(stmt, 1, names[i], -1, SQLITE_STATIC);
+            result = sqlite3_step(stmt);
+            ids[i] = sqlite3_last_insert_rowid(db);
+            rmbrl_db_release(stmt);
+        }
+        else if (result == SQLITE_ROW)
+        {
+            result = SQLITE_DONE;
+        }
+
+        if (result != SQLITE_DONE)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember tag: %s\n", sqlite3_errmsg(db));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Tags the memory with every tag of ids, a tag given twice is only stored once.
+int rmbrl_db_tag_memory(sqlite3 *db, const sqlite3_int64 *ids, size_t count,
+                        sqlite3_int64 memory_id)
+{
+    if (count == 0)
+        return 0;
+
+    sqlite3_stmt *stmt;
+    if (rmbrl_db_prepare(db, "INSERT OR IGNORE INTO memory_tags(tag_id, memory_id) VALUES (?, ?);",
+                         &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    int result = SQLITE_DONE;
+    sqlite3_bind_int64(stmt, 2, memory_id);
+    for (size_t i = 0; i < count && result == SQLITE_DONE; ++i)
+    {
+        sqlite3_bind_int64(stmt, 1, ids[i]);
+        result = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    rmbrl_db_release(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember tag: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    return 0;
+}
+
+// Looks up the tags of a filter, rarest first. A tag that was never used gets id 0, which no tag
+// has, so it matches nothing.
+int rmbrl_db_find_tags(sqlite3 *db, Rmbrl_Command *cmd, Rmbrl_Tag *tags)
+{
+    for (size_t i = 0; i < cmd->tags_count; ++i)
+    {
+        sqlite3_stmt *stmt;
+        if (rmbrl_db_prepare(db, "SELECT id, count FROM tags WHERE name = ?;", &stmt) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+            return 1;
+        }
+        sqlite3_bind_text(stmt, 1, cmd->tags[i], -1, SQLITE_STATIC);
+        int result = sqlite3_step(stmt);
+        Rmbrl_Tag tag = {0};
+        if (result == SQLITE_ROW)
+        {
+            tag.id = sqlite3_column_int64(stmt, 0);
+            tag.count = sqlite3_column_int64(stmt, 1);
+        }
+        rmbrl_db_release(stmt);
+        if (result != SQLITE_ROW && result != SQLITE_DONE)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to look up tag: %s\n", sqlite3_errmsg(db));
+            return 1;
+        }
+
+        size_t j = i;
+        for (; j > 0 && tags[j - 1].count > tag.count; --j)
+            tags[j] = tags[j - 1];
+        tags[j] = tag;
+    }
+    return 0;
+}
+
+// Appends a check for every tag from first on to a query on memories, named :tag0, :tag1, ...
+// after their index. Each one is a lookup of the memory_tags primary key.
+void rmbrl_tags_append_filter(Rmbrl_String_Builder *sb, size_t first, size_t count)
+{
+    for (size_t i = first; i < count; ++i)
+    {
+        char clause[128];
+        snprintf(clause, sizeof(clause),
+                 " AND EXISTS (SELECT 1 FROM memory_tags WHERE tag_id = :tag%zu AND "
+                 "memory_id = memories.id)",
+                 i);
+        rmbrl_sb_append_cstr(sb, clause);
+    }
+}
+
+void rmbrl_tags_bind(sqlite3_stmt *stmt, const Rmbrl_Tag *tags, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), ":tag%zu", i);
+        int index = sqlite3_bind_parameter_index(stmt, name);
+        if (index > 0)
+            sqlite3_bind_int64(stmt, index, tags[i].id);
+    }
+}
+
+int rmbrl_command_add_stdin(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (cmd->project && strlen(cmd->project) > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
+                  cmd->project);
+        return 1;
+    }
+
+    if (!rmbrl_tags_check(cmd))
+        return 1;
+
+    if (cmd->dry_run)
+        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. Memories will NOT be remembered!\n");
+
+    // One transaction for the whole import, or one per batch. A dry run only reads and checks the
+    // tasks, without a transaction or even a statement.
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_int64 tag_ids[RMBRL_MAX_TAGS];
+    if (!cmd->dry_run)
+    {
+        if (rmbrl_db_begin_transaction(db, cmd->verbosity) != 0)
+            return 1;
+        rmbrl_snapshot_begin(db);
+
+        sqlite3_int64 project_id;
+        if (rmbrl_db_intern_project(db, cmd->project ? cmd->project : "", &project_id) != 0 ||
+            rmbrl_db_intern_tags(db, cmd->tags, cmd->tags_count, tag_ids) != 0)
+        {
+            rmbrl_db_rollback_transaction(db, cmd->verbosity);
+            return 1;
+        }
+
+        const char *raw_stmt = "INSERT INTO memories (task, project_id, due_at) VALUES (?, ?, ?);";
+        if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+            rmbrl_db_rollback_transaction(db, cmd->verbosity);
+            return 1;
+        }
+
+        sqlite3_bind_int64(stmt, 2, project_id);
+        if (cmd->due_at != 0)
+            sqlite3_bind_int64(stmt, 3, cmd->due_at);
+    }
+
+    char delim = cmd->null_delimited ? '\0' : '\n';
+    char task[256 + 2];
+    size_t line = 0;
+    size_t added = 0;
+    size_t pending = 0;
+    size_t rejected = 0;
+    int result = 0;
+    long len;
+    while ((len = rmbrl_read_record(cmd->input, delim, task, sizeof(task))) != -1)
+    {
+        ++line;
+        if (!cmd->null_delimited && len > 0 && len < (long)sizeof(task) && task[len - 1] == '\r')
+            task[--len] = '\0';
+        if (len == 0)
+            continue;
+        if (len > 256)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Task on line %zu exceeds char limit of 256 bytes.\n", line);
+            ++rejected;
+            continue;
+        }
+
+        if (stmt != NULL)
+        {
+            sqlite3_bind_text(stmt, 1, task, (int)len, SQLITE_STATIC);
+            if (sqlite3_step(stmt) != SQLITE_DONE)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember line %zu: %s\n", line,
+                          sqlite3_errmsg(db));
+                result = 1;
+                break;
+            }
+            sqlite3_reset(stmt);
+            if (rmbrl_db_tag_memory(db, tag_ids, cmd->tags_count,
+                                    sqlite3_last_insert_rowid(db)) != 0)
+            {
+                result = 1;
+                break;
+            }
+        }
+
+        if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "\"%s\" was added to your memory!\n", task);
+
+        ++pending;
+        if (!cmd->dry_run && pending == cmd->batch_size)
+        {
+            if (rmbrl_db_commit_transaction(db, cmd->verbosity) != 0 ||
+                rmbrl_db_begin_transaction(db, cmd->verbosity) != 0)
+            {
+                result = 1;
+                break;
+            }
+            added += pending;
+            pending = 0;
+        }
+    }
+    if (stmt != NULL)
+        rmbrl_db_release(stmt);
+
+    if (result == 0 && ferror(cmd->input))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read stdin: %s\n", strerror(errno));
+        result = 1;
+    }
+
+    if (result != 0 && !cmd->dry_run)
+    {
+        if (rmbrl_db_rollback_transaction(db, cmd->verbosity) != 0)
+            result = 1;
+    }
+    else if (!cmd->dry_run)
+    {
+        rmbrl_snapshot_refresh(db, cmd->project ? cmd->project : "");
+        if (rmbrl_db_commit_transaction(db, cmd->verbosity) != 0)
+        {
+            result = 1;
+        }
+        else
+        {
+            added += pending;
+            rmbrl_snapshot_commit(db);
+        }
+    }
+
+    if (result != 0 && added > 0)
+        rmbrl_log(RMBRL_LOG_WARNING, "%zu memories from earlier batches were remembered.\n", added);
+    else if (result == 0 && cmd->verbosity != RMBRL_VERB_SILENT)
+        rmbrl_log(RMBRL_LOG_INFO, "%zu memories were added to your memory!\n",
+                  cmd->dry_run ? pending : added);
+
+    if (rejected > 0)
+        result = 1;
+
+    return result;
+}
+
+int rmbrl_command_add_preview(Rmbrl_Command *cmd, sqlite3 *db);
+
+int rmbrl_command_add(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (cmd->from_stdin)
+        return rmbrl_command_add_stdin(cmd, db);
+
+    if (strlen(cmd->task) > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Task \"%s\" exceeds char limit of 256 bytes.\n", cmd->task);
+        return 1;
+    }
+    if (cmd->project && strlen(cmd->project) > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
+                  cmd->project);
+        return 1;
+    }
+    if (!rmbrl_tags_check(cmd))
+        return 1;
+
+    if (cmd->dry_run)
+        return rmbrl_command_add_preview(cmd, db);
+
+    // the snapshot is refreshed inside of the same transaction, so it matches what is committed
+    int result = rmbrl_db_begin_transaction(db, cmd->verbosity);
+    if (result != 0)
+        return result;
+    rmbrl_snapshot_begin(db);
+
+    sqlite3_int64 project_id;
+    sqlite3_int64 tag_ids[RMBRL_MAX_TAGS];
+    if (rmbrl_db_intern_project(db, cmd->project ? cmd->project : "", &project_id) != 0 ||
+        rmbrl_db_intern_tags(db, cmd->tags, cmd->tags_count, tag_ids) != 0)
+        RMBRL_CLEANUP_RETURN(1);
+
+    sqlite3_stmt *stmt;
+    const char *raw_stmt = "INSERT INTO memories (task, project_id, due_at) VALUES (?, ?, ?);";
+    if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        RMBRL_CLEANUP_RETURN(1);
+    }
+
+    sqlite3_bind_text(stmt, 1, cmd->task, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, project_id);
+    if (cmd->due_at != 0)
+        sqlite3_bind_int64(stmt, 3, cmd->due_at);
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+    {
+        char *stmt_str = sqlite3_expanded_sql(stmt);
+        rmbrl_log(RMBRL_LOG_INFO, "Query: %s\n", stmt_str);
+        sqlite3_free(stmt_str);
+    }
+
+    result = sqlite3_step(stmt);
+    rmbrl_db_release(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember: %s\n", sqlite3_errmsg(db));
+        RMBRL_CLEANUP_RETURN(1);
+    }
+    if (rmbrl_db_tag_memory(db, tag_ids, cmd->tags_count, sqlite3_last_insert_rowid(db)) != 0)
+        RMBRL_CLEANUP_RETURN(1);
+
+    rmbrl_snapshot_refresh(db, cmd->project ? cmd->project : "");
+    result = rmbrl_db_commit_transaction(db, cmd->verbosity);
+    if (result != 0)
+        return result;
+    rmbrl_snapshot_commit(db);
+
+    rmbrl_log(RMBRL_LOG_INFO, "\"%s\" was added to your memory!\n", cmd->task);
+
+    return 0;
+
+cleanup:
+    rmbrl_snapshot_abort();
+    rmbrl_db_rollback_transaction(db, cmd->verbosity);
+    return result;
+}
+
+// Write log
+//
+// With `--backend log` `add` appends the memory to a log next to the database ("rmbrl.db-wlog")
+// instead of running a SQLite transaction: a single write(2) with O_APPEND, no journal, no page
+// writes. The log starts with a header naming its generation, every record is the size of the
+// memory, its FNV-1a checksum and the memory itself. Appends survive a crash of the process the
+// same way commits with synchronous = NORMAL do, a record cut short fails its checksum and ends
+// the log.
+//
+// Pending memories are folded into memories in log order by whichever command opens the store
+// read-write next, by `add` once the log outgrows RMBRL_WLOG_FOLD_BYTES, or by `rmbrl compact`.
+// The fold stores the generation and offset it reached in wlog_state inside of its transaction
+// and only truncates the log after committing, so a crash in between never folds a memory twice.
+// Folding in log order also means AUTOINCREMENT hands out ids one after another, the id a pending
+// memory will get is known before it is folded. peek merges pending memories with the store,
+// every other command reads the store once the log is folded.
+//
+// The log is locked with flock(2): appends and folds exclusively, peek shared while it reads the
+// log and starts the read transaction of its query, so it never sees a memory in both places.
+
+#ifndef RMBRL_WLOG_FOLD_BYTES
+#define RMBRL_WLOG_FOLD_BYTES (64 * 1024)
+#endif
+
+#define RMBRL_WLOG_MAGIC "RMBRLWL1"
+#define RMBRL_WLOG_HEADER_SIZE 16        // magic and generation
+#define RMBRL_WLOG_RECORD_HEADER_SIZE 8  // size and checksum of the memory
+#define RMBRL_WLOG_MEMORY_HEADER_SIZE 10 // created_at and the size of the project
+
+typedef struct
+{
+    sqlite3_int64 id; // the id the memory gets once folded
+    sqlite3_int64 created_at;
+    const char *task;
+    int task_size;
+    const char *project;
+    int project_size;
+    size_t end; // offset of the next record
+} Rmbrl_Wlog_Record;
+
+typedef struct
+{
+    unsigned char *data; // contents of the log, records point into it
+    size_t size;
+    size_t valid_size; // up to the first damaged record
+    uint64_t generation;
+    Rmbrl_Wlog_Record *items;
+    size_t capacity;
+    size_t count;
+    bool began; // rmbrl_wlog_read_pending started the read transaction of its caller
+} Rmbrl_Wlog;
+
+static inline uint32_t rmbrl_le32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t rmbrl_le64(const unsigned char *p)
+{
+    return (uint64_t)rmbrl_le32(p) | (uint64_t)rmbrl_le32(p + 4) << 32;
+}
+
+static inline void rmbrl_put_le32(unsigned char *p, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        p[i] = (unsigned char)(value >> (8 * i));
+}
+
+static inline void rmbrl_put_le64(unsigned char *p, uint64_t value)
+{
+    rmbrl_put_le32(p, (uint32_t)value);
+    rmbrl_put_le32(p + 4, (uint32_t)(value >> 32));
+}
+
+uint32_t rmbrl_fnv1a(const unsigned char *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+// Returns false for stores without a file, they cannot have a log.
+bool rmbrl_wlog_path(const char *db_path, char *wlog_path, size_t wlog_path_size)
+{
+    if (db_path == NULL || *db_path == '\0' || strcmp(db_path, ":memory:") == 0)
+        return false;
+    return snprintf(wlog_path, wlog_path_size, "%s-wlog", db_path) < (int)wlog_path_size;
+}
+
+// True if the log of the store at db_path holds records that may not be folded yet.
+bool rmbrl_wlog_pending(const char *db_path)
+{
+    char wlog_path[1024];
+    struct stat st;
+    return rmbrl_wlog_path(db_path, wlog_path, sizeof(wlog_path)) && stat(wlog_path, &st) == 0 &&
+           st.st_size > RMBRL_WLOG_HEADER_SIZE;
+}
+
+void rmbrl_wlog_free(Rmbrl_Wlog *wlog)
+{
+    RMBRL_FREE(wlog->data);
+    RMBRL_FREE(wlog->items);
+    memset(wlog, 0, sizeof(*wlog));
+}
+
+#ifndef _WIN32
+bool rmbrl_write_all(int fd, const void *data, size_t size);
+bool rmbrl_read_all(int fd, void *data, size_t size);
+
+// flock(2) that backs off like rmbrl_db_busy_handler while the latency budget lasts instead of
+// blocking, fails with EWOULDBLOCK once it ran out.
+int rmbrl_wlog_lock(int fd, int operation)
+{
+    if (rmbrl_budget.deadline_ns == 0)
+        return flock(fd, operation);
+
+    for (int count = 0;; ++count)
+    {
+        if (flock(fd, operation | LOCK_NB) == 0)
+            return 0;
+        int remaining_ms = rmbrl_budget_remaining_ms();
+        if (errno != EWOULDBLOCK || remaining_ms == 0)
+            return -1;
+
+        int sleep_ms = count < 6 ? 1 << count : RMBRL_BUSY_MAX_SLEEP_MS;
+        if (sleep_ms > RMBRL_BUSY_MAX_SLEEP_MS)
+            sleep_ms = RMBRL_BUSY_MAX_SLEEP_MS;
+        sqlite3_sleep(sleep_ms < remaining_ms ? sleep_ms : remaining_ms);
+    }
+}
+
+// Reads the log from the locked fd and splits it into records, up to the first damaged one.
+int rmbrl_wlog_read(int fd, const char *wlog_path, Rmbrl_Wlog *wlog)
+{
+    memset(wlog, 0, sizeof(*wlog));
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read %s: %s\n", wlog_path, strerror(errno));
+        return 1;
+    }
+    if (st.st_size == 0)
+        return 0;
+
+    wlog->size = (size_t)st.st_size;
+    wlog->data = RMBRL_REALLOC(NULL, wlog->size);
+    RMBRL_ASSERT(wlog->data != NULL && "Buy more RAM lol");
+    if (!rmbrl_read_all(fd, wlog->data, wlog->size))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read %s: %s\n", wlog_path, strerror(errno));
+        rmbrl_wlog_free(wlog);
+        return 1;
+    }
+
+    if (wlog->size < RMBRL_WLOG_HEADER_SIZE ||
+        memcmp(wlog->data, RMBRL_WLOG_MAGIC, strlen(RMBRL_WLOG_MAGIC)) != 0)
+        return 0;
+    wlog->generation = rmbrl_le64(wlog->data + 8);
+
+    size_t offset = RMBRL_WLOG_HEADER_SIZE;
+    while (wlog->size - offset >= RMBRL_WLOG_RECORD_HEADER_SIZE)
+    {
+        const unsigned char *record = wlog->data + offset;
+        size_t size = rmbrl_le32(record);
+        const unsigned char *memory = record + RMBRL_WLOG_RECORD_HEADER_SIZE;
+        if (size < RMBRL_WLOG_MEMORY_HEADER_SIZE ||
+            size > wlog->size - offset - RMBRL_WLOG_RECORD_HEADER_SIZE ||
+            rmbrl_fnv1a(memory, size) != rmbrl_le32(record + 4))
+            break;
+
+        Rmbrl_Wlog_Record item = {0};
+        item.created_at = (sqlite3_int64)rmbrl_le64(memory);
+        item.project_size = memory[8] | memory[9] << 8;
+        if ((size_t)item.project_size > size - RMBRL_WLOG_MEMORY_HEADER_SIZE)
+            break;
+        item.project = (const char *)memory + RMBRL_WLOG_MEMORY_HEADER_SIZE;
+        item.task = item.project + item.project_size;
+        item.task_size = (int)(size - RMBRL_WLOG_MEMORY_HEADER_SIZE) - item.project_size;
+        offset += RMBRL_WLOG_RECORD_HEADER_SIZE + size;
+        item.end = offset;
+        rmbrl_da_append(wlog, item);
+    }
+    wlog->valid_size = offset;
+    return 0;
+}
+
+// Drops the records wlog_state says are folded already and gives the rest the ids they will get.
+// Called inside of the transaction that reads or folds them.
+int rmbrl_wlog_skip_folded(sqlite3 *db, Rmbrl_Wlog *wlog, sqlite3_int64 *folded)
+{
+    sqlite3_stmt *stmt;
+    if (rmbrl_db_prepare(db, "SELECT (SELECT folded FROM wlog_state WHERE generation = ?), "
+                             "(SELECT seq FROM sqlite_sequence WHERE name = 'memories');",
+                         &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)wlog->generation);
+    int result = sqlite3_step(stmt);
+    *folded = sqlite3_column_int64(stmt, 0);
+    sqlite3_int64 seq = sqlite3_column_int64(stmt, 1);
+    rmbrl_db_release(stmt);
+    if (result != SQLITE_ROW)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read the write log state: %s\n",
+                  sqlite3_errmsg(db));
+        return 1;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < wlog->count; ++i)
+    {
+        if ((sqlite3_int64)wlog->items[i].end <= *folded)
+            continue;
+        wlog->items[kept] = wlog->items[i];
+        wlog->items[kept].id = seq + (sqlite3_int64)kept + 1;
+        kept++;
+    }
+    wlog->count = kept;
+    return 0;
+}
+#endif // end _WIN32
+
+// Appends cmd's memory to the log of the store at db_path, log_size is its size afterwards.
+// Returns -1 if the store cannot have a log and the memory has to be added to it directly.
+int rmbrl_wlog_append(Rmbrl_Command *cmd, const char *db_path, size_t *log_size)
+{
+#ifdef _WIN32
+    (void)cmd;
+    (void)db_path;
+    (void)log_size;
+    return -1;
+#else
+    char wlog_path[1024];
+    if (!rmbrl_wlog_path(db_path, wlog_path, sizeof(wlog_path)))
+        return -1;
+
+    size_t task_size = strlen(cmd->task);
+    size_t project_size = cmd->project ? strlen(cmd->project) : 0;
+    if (task_size > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Task \"%s\" exceeds char limit of 256 bytes.\n", cmd->task);
+        return 1;
+    }
+    if (project_size > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
+                  cmd->project);
+        return 1;
+    }
+
+    // the header is only written along with the first record of a log
+    unsigned char buf[RMBRL_WLOG_HEADER_SIZE + RMBRL_WLOG_RECORD_HEADER_SIZE +
+                      RMBRL_WLOG_MEMORY_HEADER_SIZE + 2 * 256];
+    unsigned char *record = buf + RMBRL_WLOG_HEADER_SIZE;
+    unsigned char *memory = record + RMBRL_WLOG_RECORD_HEADER_SIZE;
+    size_t memory_size = RMBRL_WLOG_MEMORY_HEADER_SIZE + project_size + task_size;
+
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    rmbrl_put_le64(memory, (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000);
+    memory[8] = (unsigned char)project_size;
+    memory[9] = (unsigned char)(project_size >> 8);
+    memcpy(memory + RMBRL_WLOG_MEMORY_HEADER_SIZE, cmd->project ? cmd->project : "", project_size);
+    memcpy(memory + RMBRL_WLOG_MEMORY_HEADER_SIZE + project_size, cmd->task, task_size);
+    rmbrl_put_le32(record, (uint32_t)memory_size);
+    rmbrl_put_le32(record + 4, rmbrl_fnv1a(memory, memory_size));
+
+    int fd = open(wlog_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to open %s: %s\n", wlog_path, strerror(errno));
+        return 1;
+    }
+
+    struct stat st;
+    int result = rmbrl_wlog_lock(fd, LOCK_EX) == 0 && fstat(fd, &st) == 0 ? 0 : 1;
+    unsigned char *start = record;
+    if (result == 0 && st.st_size == 0)
+    {
+        // a new generation tells this log apart from the ones folded before it
+        start = buf;
+        memcpy(buf, RMBRL_WLOG_MAGIC, strlen(RMBRL_WLOG_MAGIC));
+        uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+        rmbrl_put_le64(buf + 8, now_ns ^ (uint64_t)getpid() << 40);
+    }
+    size_t size = (size_t)(memory + memory_size - start);
+    if (result == 0 && !rmbrl_write_all(fd, start, size))
+    {
+        // a partial record would end the log for every record appended after it, if it cannot be
+        // cut off its checksum still tells the fold where the log ends
+        if (ftruncate(fd, st.st_size) != 0 && cmd->verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "Failed to truncate %s: %s\n", wlog_path, strerror(errno));
+        result = 1;
+    }
+    if (result != 0)
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to write %s: %s\n", wlog_path, strerror(errno));
+    else
+        *log_size = (size_t)st.st_size + size;
+    close(fd);
+    return result;
+#endif // end _WIN32
+}
+
+// Ends the read transaction rmbrl_wlog_read_pending started, if it started one.
+void rmbrl_wlog_end_read(sqlite3 *db, Rmbrl_Wlog *wlog)
+{
+    if (wlog->began)
+        sqlite3_exec(db, "COMMIT;", NULL, 0, NULL);
+    wlog->began = false;
+}
+
+// Reads the memories of the log that are not folded yet for peek. If there are any, the read
+// transaction of the caller's query is started while the log is locked and has to be ended by the
+// caller with rmbrl_wlog_end_read. A transaction that is already open, e.g. the one of a script,
+// is used as it is.
+int rmbrl_wlog_read_pending(sqlite3 *db, Rmbrl_Wlog *wlog)
+{
+    memset(wlog, 0, sizeof(*wlog));
+#ifdef _WIN32
+    (void)db;
+    return 0;
+#else
+    char wlog_path[1024];
+    if (!rmbrl_wlog_path(sqlite3_db_filename(db, "main"), wlog_path, sizeof(wlog_path)))
+        return 0;
+    int fd = open(wlog_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
+
+    int result = 0;
+    if (rmbrl_wlog_lock(fd, LOCK_SH) != 0 || rmbrl_wlog_read(fd, wlog_path, wlog) != 0)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read %s: %s\n", wlog_path, strerror(errno));
+        result = 1;
+    }
+
+    sqlite3_int64 folded;
+    if (result == 0 && wlog->count > 0)
+    {
+        if (sqlite3_get_autocommit(db))
+        {
+            wlog->began = sqlite3_exec(db, "BEGIN;", NULL, 0, NULL) == SQLITE_OK;
+            if (!wlog->began)
+                result = 1;
+        }
+        if (result == 0 && rmbrl_wlog_skip_folded(db, wlog, &folded) != 0)
+            result = 1;
+        if (result != 0 || wlog->count == 0)
+            rmbrl_wlog_end_read(db, wlog);
+    }
+    close(fd);
+
+    if (result != 0 || wlog->count == 0)
+        rmbrl_wlog_free(wlog);
+    return result;
+#endif // end _WIN32
+}
+
+// Folds the log of the store into memories, folded is the number of memories it added. On errors
+// the log is left alone for the next fold.
+int rmbrl_wlog_fold(sqlite3 *db, Rmbrl_Verbosity_Level verbosity, size_t *folded)
+{
+    *folded = 0;
+#ifdef _WIN32
+    (void)db;
+    (void)verbosity;
+    return 0;
+#else
+    char wlog_path[1024];
+    if (!rmbrl_wlog_path(sqlite3_db_filename(db, "main"), wlog_path, sizeof(wlog_path)))
+        return 0;
+    int fd = open(wlog_path, O_RDWR | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
+
+    Rmbrl_Wlog wlog;
+    if (rmbrl_wlog_lock(fd, LOCK_EX) != 0 || rmbrl_wlog_read(fd, wlog_path, &wlog) != 0)
+    {
+        close(fd);
+        return 1;
+    }
+    if (wlog.size <= RMBRL_WLOG_HEADER_SIZE)
+    {
+        rmbrl_wlog_free(&wlog);
+        close(fd);
+        return 0;
+    }
+
+    sqlite3_int64 offset;
+    sqlite3_stmt *stmt = NULL;
+    int result = rmbrl_db_begin_transaction(db, verbosity);
+    if (result == 0)
+    {
+        rmbrl_snapshot_begin(db);
+        result = rmbrl_wlog_skip_folded(db, &wlog, &offset);
+    }
+    if (result == 0 && rmbrl_db_prepare(db,
+                                        "INSERT INTO memories (task, project_id, created_at) "
+                                        "VALUES (?, ?, ?);",
+                                        &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        result = 1;
+    }
+
+    // hooks add to the same project over and over, it is only looked up when it changes
+    char project[256 + 1] = "";
+    sqlite3_int64 project_id = 0;
+    bool interned = false;
+    for (size_t i = 0; result == 0 && i < wlog.count; ++i)
+    {
+        Rmbrl_Wlog_Record *record = &wlog.items[i];
+        if (!interned || strlen(project) != (size_t)record->project_size ||
+            memcmp(project, record->project, (size_t)record->project_size) != 0)
+        {
+            int project_size = record->project_size < 256 ? record->project_size : 256;
+            memcpy(project, record->project, (size_t)project_size);
+            project[project_size] = '\0';
+            interned = rmbrl_db_intern_project(db, project, &project_id) == 0;
+            if (!interned)
+            {
+                result = 1;
+                break;
+            }
+        }
+
+        sqlite3_bind_text(stmt, 1, record->task, record->task_size, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, project_id);
+        sqlite3_bind_int64(stmt, 3, record->created_at);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to fold %s: %s\n", wlog_path, sqlite3_errmsg(db));
+            result = 1;
+        }
+        sqlite3_reset(stmt);
+    }
+    if (stmt != NULL)
+        rmbrl_db_release(stmt);
+
+    if (result == 0)
+    {
+        const char *raw_stmt = "INSERT OR REPLACE INTO wlog_state (id, generation, folded) "
+                               "VALUES (1, ?, ?);";
+        result = rmbrl_db_prepare(db, raw_stmt, &stmt) == SQLITE_OK ? 0 : 1;
+        if (result == 0)
+        {
+            sqlite3_bind_int64(stmt, 1, (sqlite3_int64)wlog.generation);
+            sqlite3_bind_int64(stmt, 2, (sqlite3_int64)wlog.valid_size);
+            result = sqlite3_step(stmt) == SQLITE_DONE ? 0 : 1;
+            rmbrl_db_release(stmt);
+        }
+        if (result != 0)
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to fold %s: %s\n", wlog_path, sqlite3_errmsg(db));
+    }
+
+    if (result == 0)
+    {
+        if (wlog.count > 0)
+            rmbrl_snapshot_refresh_all(db, true);
+        result = rmbrl_db_commit_transaction(db, verbosity);
+    }
+    else
+    {
+        rmbrl_db_rollback_transaction(db, verbosity);
+    }
+
+    if (result == 0)
+    {
+        rmbrl_snapshot_commit(db);
+        *folded = wlog.count;
+        if (wlog.valid_size < wlog.size)
+            rmbrl_log(RMBRL_LOG_WARNING, "Dropped %zu bytes of %s after a damaged record\n",
+                      wlog.size - wlog.valid_size, wlog_path);
+        // wlog_state already knows the records are folded, a failed truncate only costs a read
+        if (ftruncate(fd, 0) != 0 && verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "Failed to truncate %s: %s\n", wlog_path, strerror(errno));
+        if (verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "Folded %zu memories from %s\n", *folded, wlog_path);
+    }
+
+    rmbrl_wlog_free(&wlog);
+    close(fd);
+    return result;
+#endif // end _WIN32
+}
+
+int rmbrl_command_compact(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (cmd->dry_run)
+    {
+        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. The write log will NOT be folded!\n");
+        return 0;
+    }
+
+    size_t folded;
+    if (rmbrl_wlog_fold(db, cmd->verbosity, &folded) != 0)
+        return 1;
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT)
+        rmbrl_log(RMBRL_LOG_INFO, "Folded %zu memories into the store\n", folded);
+    return 0;
+}
+
+// The row a dry run of add would insert. Nothing is written and no write lock is taken: the id is
+// the one AUTOINCREMENT hands out once the memories still pending in the write log are folded,
+// and the project and tags are looked up instead of interned.
+int rmbrl_command_add_preview(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. Memory will NOT be remembered!\n");
+
+    // the read transaction started for pending memories covers the queries below as well
+    static Rmbrl_Wlog wlog;
+    if (rmbrl_wlog_read_pending(db, &wlog) != 0)
+        return 1;
+    sqlite3_int64 next_id = (sqlite3_int64)wlog.count + 1;
+
+    const char *project = cmd->project ? cmd->project : "";
+    sqlite3_stmt *stmt;
+    const char *raw_stmt =
+        "SELECT coalesce((SELECT seq FROM sqlite_sequence WHERE name = 'memories'), 0), "
+        "EXISTS (SELECT 1 FROM projects WHERE name = ?);";
+    bool prepared = rmbrl_db_prepare(db, raw_stmt, &stmt) == SQLITE_OK;
+    if (prepared)
+        sqlite3_bind_text(stmt, 1, project, -1, SQLITE_STATIC);
+    if (!prepared || sqlite3_step(stmt) != SQLITE_ROW)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to preview memory: %s\n", sqlite3_errmsg(db));
+        if (prepared)
+            rmbrl_db_release(stmt);
+        rmbrl_wlog_end_read(db, &wlog);
+        rmbrl_wlog_free(&wlog);
+        return 1;
+    }
+    next_id += sqlite3_column_int64(stmt, 0);
+    bool project_exists = sqlite3_column_int(stmt, 1) != 0;
+    rmbrl_db_release(stmt);
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+    {
+        if (!project_exists && project[0] != '\0')
+            rmbrl_log(RMBRL_LOG_INFO, "Project \"%s\" would be created.\n", project);
+        for (size_t i = 0; i < cmd->tags_count; ++i)
+        {
+            if (rmbrl_db_prepare(db, "SELECT 1 FROM tags WHERE name = ?;", &stmt) != SQLITE_OK)
+                continue;
+            sqlite3_bind_text(stmt, 1, cmd->tags[i], -1, SQLITE_STATIC);
+            bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+            rmbrl_db_release(stmt);
+            if (!exists)
+                rmbrl_log(RMBRL_LOG_INFO, "Tag \"%s\" would be created.\n", cmd->tags[i]);
+        }
+    }
+
+    rmbrl_wlog_end_read(db, &wlog);
+    rmbrl_wlog_free(&wlog);
+
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, cmd->format, cmd->verbosity);
+    out.due = cmd->due_at != 0;
+    out.now = rmbrl_now_ms();
+    if (cmd->verbosity != RMBRL_VERB_SILENT && cmd->format == RMBRL_FORMAT_TEXT)
+        rmbrl_out_cstr(&out, "[INFO] Would Remember:\n");
+    rmbrl_out_memory_fields(&out, next_id, (const unsigned char *)cmd->task, (int)strlen(cmd->task),
+                            (const unsigned char *)project, (int)strlen(project), out.now,
+                            cmd->due_at, NULL, 0);
+    rmbrl_out_end(&out);
+
+    return 0;
+}
+
+// The snapshot only knows the latest memory, so --cached serves plain peeks and falls back to the
+// database for --all, --limit greater than 1 and --after.
+bool rmbrl_command_peek_is_cacheable(Rmbrl_Command *cmd)
+{
+    return cmd->cached && !cmd->global && !cmd->by_due && !cmd->watch && cmd->tags_count == 0 &&
+           !cmd->all && (!cmd->has_limit || cmd->limit == 1) && cmd->after_id == 0;
+}
+
+// Serves peek from the snapshot without opening the database, see "Prompt snapshot".
+// Returns 0 once the memory was printed, or -1 if the caller has to read it from the database.
+int rmbrl_command_peek_cached(Rmbrl_Command *cmd, const char *db_path)
+{
+    // the snapshot only knows about memories in the store
+    if (!rmbrl_command_peek_is_cacheable(cmd) || rmbrl_wlog_pending(db_path))
+        return -1;
+
+    char snap_path[1024];
+    Rmbrl_Snapshot_Sig sig;
+    if (snprintf(snap_path, sizeof(snap_path), "%s-snap", db_path) >= (int)sizeof(snap_path) ||
+        !rmbrl_snapshot_sig(db_path, &sig))
+        return -1;
+
+    const Rmbrl_Snapshot *snap = rmbrl_snapshot_map(snap_path);
+    if (snap == NULL)
+        return -1;
+
+    const Rmbrl_Snapshot_Slot *slot = NULL;
+    bool hit = false;
+    if (rmbrl_snapshot_is_current(snap, &sig))
+    {
+        slot = rmbrl_snapshot_find(snap, cmd->project);
+        // a complete snapshot without a slot means the project has no memories
+        hit = slot != NULL || snap->complete;
+    }
+    if (slot != NULL && (slot->task_size < 0 || slot->task_size >= (int)sizeof(slot->task) ||
+                         slot->project_size < 0 ||
+                         slot->project_size >= (int)sizeof(slot->project)))
+        hit = false;
+
+    if (!hit)
+    {
+        rmbrl_snapshot_unmap(snap);
+        if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "Snapshot is stale, reading the database\n");
+        return -1;
+    }
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "Serving snapshot generation %lld\n",
+                  (long long)snap->generation);
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT && cmd->format == RMBRL_FORMAT_TEXT)
+        rmbrl_log(RMBRL_LOG_INFO, "Currently Remembering:\n");
+
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, cmd->format, cmd->verbosity);
+    if (slot != NULL && slot->id != 0)
+        rmbrl_out_memory_fields(&out, slot->id, (const unsigned char *)slot->task,
+                                slot->task_size, (const unsigned char *)slot->project,
+                                slot->project_size, slot->created_at, 0, NULL, 0);
+    rmbrl_out_end(&out);
+
+    rmbrl_snapshot_unmap(snap);
+    return 0;
+}
+
+// Keeps the pending memories peek shows, newest first. Returns 1 if the --after cursor is one of
+// them, along with its created_at, and -1 on errors.
+int rmbrl_command_peek_pending(Rmbrl_Command *cmd, sqlite3 *db, Rmbrl_Wlog *wlog,
+                               sqlite3_int64 *after_created_at)
+{
+    if (wlog->count == 0)
+        return 0;
+
+    // a cursor in the store is compared by its key, only pending memories before it are kept
+    Rmbrl_Wlog_Record cursor = {0};
+    bool cursor_pending = false;
+    if (cmd->after_id > 0)
+    {
+        for (size_t i = 0; i < wlog->count && !cursor_pending; ++i)
+        {
+            cursor_pending = wlog->items[i].id == cmd->after_id;
+            if (cursor_pending)
+                cursor = wlog->items[i];
+        }
+
+        sqlite3_stmt *stmt;
+        if (!cursor_pending)
+        {
+            if (rmbrl_db_prepare(db, "SELECT created_at FROM memories WHERE id = ?;", &stmt) !=
+                SQLITE_OK)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n",
+                          sqlite3_errmsg(db));
+                return -1;
+            }
+            sqlite3_bind_int64(stmt, 1, cmd->after_id);
+            // an unknown cursor shows nothing, like the query of the store
+            cursor.created_at = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0)
+                                                                 : INT64_MIN;
+            cursor.id = cmd->after_id;
+            rmbrl_db_release(stmt);
+        }
+    }
+
+    size_t project_size = cmd->project ? strlen(cmd->project) : 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < wlog->count; ++i)
+    {
+        Rmbrl_Wlog_Record *record = &wlog->items[i];
+        if (cmd->project && ((size_t)record->project_size != project_size ||
+                             memcmp(record->project, cmd->project, project_size) != 0))
+            continue;
+        if (cmd->after_id > 0 && (record->created_at > cursor.created_at ||
+                                  (record->created_at == cursor.created_at &&
+                                   record->id >= cursor.id)))
+            continue;
+        wlog->items[kept++] = *record;
+    }
+    wlog->count = kept;
+
+    // appended in time order, unless the clock went backwards in between
+    for (size_t i = 0; i < kept / 2; ++i)
+    {
+        Rmbrl_Wlog_Record record = wlog->items[i];
+        wlog->items[i] = wlog->items[kept - 1 - i];
+        wlog->items[kept - 1 - i] = record;
+    }
+    for (size_t i = 1; i < kept; ++i)
+    {
+        Rmbrl_Wlog_Record record = wlog->items[i];
+        size_t j = i;
+        for (; j > 0 && (wlog->items[j - 1].created_at < record.created_at ||
+                         (wlog->items[j - 1].created_at == record.created_at &&
+                          wlog->items[j - 1].id < record.id));
+             --j)
+            wlog->items[j] = wlog->items[j - 1];
+        wlog->items[j] = record;
+    }
+
+    *after_created_at = cursor.created_at;
+    return cursor_pending ? 1 : 0;
+}
+
+// Lists memories with a due date, soonest first, for `rmbrl due` and `peek --by-due`. Both walk
+// memories_due_at or memories_project_due_at in (due_at, id) order: `due` stops at the end of its
+// window, peek at its limit, so neither looks at more rows than it prints. Memories in the write
+// log never have a due date, add commits those directly.
+int rmbrl_command_due(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (cmd->project && strlen(cmd->project) > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
+                  cmd->project);
+        return 1;
+    }
+
+    bool window = cmd->function == RMBRL_CMD_DUE && !cmd->all;
+    sqlite3_int64 limit = -1;
+    if (cmd->has_limit)
+        limit = cmd->limit;
+    else if (cmd->function == RMBRL_CMD_PEEK && !cmd->all)
+        limit = 1;
+
+    // the window or the limit already bounds the walk, every tag is checked per memory
+    Rmbrl_Tag tags[RMBRL_MAX_TAGS];
+    if (!rmbrl_tags_check(cmd) || rmbrl_db_find_tags(db, cmd, tags) != 0)
+        return 1;
+
+    Rmbrl_String_Builder raw_stmt = {0};
+    rmbrl_sb_append_cstr(&raw_stmt, "SELECT " RMBRL_MEMORY_COLUMNS ", due_at FROM memories "
+                                    "WHERE due_at IS NOT NULL AND archived_at IS NULL");
+    if (cmd->project)
+        rmbrl_sb_append_cstr(&raw_stmt,
+                             " AND project_id = (SELECT id FROM projects WHERE name = :project)");
+    rmbrl_tags_append_filter(&raw_stmt, 0, cmd->tags_count);
+    if (window)
+        rmbrl_sb_append_cstr(&raw_stmt, " AND due_at <= :until");
+    // keyset pagination like peek, continue right after the cursor row in (due_at, id) order
+    if (cmd->after_id > 0)
+        rmbrl_sb_append_cstr(&raw_stmt, " AND (due_at, id) > "
+                                        "(SELECT due_at, id FROM memories WHERE id = :after)");
+    rmbrl_sb_append_cstr(&raw_stmt, " ORDER BY due_at, id LIMIT :limit;");
+    rmbrl_sb_append_null(&raw_stmt);
+
+    sqlite3_stmt *stmt;
+    int result = rmbrl_db_prepare(db, raw_stmt.items, &stmt);
+    rmbrl_sb_free(raw_stmt);
+    if (result != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    sqlite3_int64 now = rmbrl_now_ms();
+    if (cmd->project)
+        sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":project"), cmd->project, -1,
+                          SQLITE_STATIC);
+    rmbrl_tags_bind(stmt, tags, cmd->tags_count);
+    if (window)
+        sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":until"),
+                           cmd->window_ms > INT64_MAX - now ? INT64_MAX : now + cmd->window_ms);
+    if (cmd->after_id > 0)
+        sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":after"), cmd->after_id);
+    sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":limit"), limit);
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+    {
+        char *stmt_str = sqlite3_expanded_sql(stmt);
+        rmbrl_log(RMBRL_LOG_INFO, "Query: %s\n", stmt_str);
+        sqlite3_free(stmt_str);
+    }
+
+    // the header is part of the output, --watch compares all of it
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, cmd->format, cmd->verbosity);
+    out.due = true;
+    out.now = now;
+    out.changed_only = cmd->watch;
+    if (cmd->verbosity != RMBRL_VERB_SILENT && cmd->format == RMBRL_FORMAT_TEXT)
+        rmbrl_out_cstr(&out, cmd->function == RMBRL_CMD_DUE ? "[INFO] Due Memories:\n"
+                                                            : "[INFO] Currently Remembering:\n");
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+        rmbrl_out_memory(&out, stmt);
+    rmbrl_out_end(&out);
+    rmbrl_db_release(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    return 0;
+}
+
+int rmbrl_command_peek(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (cmd->by_due)
+        return rmbrl_command_due(cmd, db);
+
+    if (cmd->project && strlen(cmd->project) > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
+                  cmd->project);
+        return 1;
+    }
+
+    // Without --all or --limit only the most recent memory is shown. The limit is part of the
+    // query, so SQLite stops walking the index once the page is full.
+    sqlite3_int64 limit = -1;
+    if (cmd->has_limit)
+        limit = cmd->limit;
+    else if (!cmd->all)
+        limit = 1;
+
+    // memories still in the write log are merged with the ones of the store, see "Write log". They
+    // never have tags, add commits memories with tags directly.
+    static Rmbrl_Wlog wlog;
+    if (cmd->tags_count == 0 && rmbrl_wlog_read_pending(db, &wlog) != 0)
+        return 1;
+    bool pending = wlog.count > 0;
+    sqlite3_int64 after_created_at = 0;
+    int result = rmbrl_command_peek_pending(cmd, db, &wlog, &after_created_at);
+    if (result == -1)
+    {
+        rmbrl_wlog_end_read(db, &wlog);
+        rmbrl_wlog_free(&wlog);
+        return 1;
+    }
+
+    // Tags are intersected from the rarest, see "Tags". The exception is a page that is expected to
+    // fill within a few memories of the recency index, e.g. peek with common tags: with tags on
+    // count of live memories, about limit * live / count of them are walked before the page is
+    // full, and walking them newest first with every tag checked is cheaper than sorting count.
+    Rmbrl_Tag tags[RMBRL_MAX_TAGS];
+    bool from_tag = false;
+    if (cmd->tags_count > 0)
+    {
+        int live = 0;
+        if (!rmbrl_tags_check(cmd) || rmbrl_db_find_tags(db, cmd, tags) != 0 ||
+            !rmbrl_db_query_int(db, "SELECT live FROM memory_totals;", &live))
+            return 1;
+        from_tag = limit < 0 || (double)limit * live >= (double)tags[0].count * tags[0].count;
+    }
+
+    Rmbrl_String_Builder raw_stmt = {0};
+    if (from_tag)
+        rmbrl_sb_append_cstr(&raw_stmt, "SELECT " RMBRL_MEMORY_COLUMNS
+                                        " FROM memory_tags AS rarest CROSS JOIN memories "
+                                        "ON memories.id = rarest.memory_id "
+                                        "WHERE rarest.tag_id = :tag0 AND archived_at IS NULL");
+    else
+        rmbrl_sb_append_cstr(&raw_stmt, "SELECT " RMBRL_MEMORY_COLUMNS
+                                        " FROM memories WHERE archived_at IS NULL");
+    if (cmd->project)
+        rmbrl_sb_append_cstr(&raw_stmt,
+                             " AND project_id = (SELECT id FROM projects WHERE name = :project)");
+    rmbrl_tags_append_filter(&raw_stmt, from_tag ? 1 : 0, cmd->tags_count);
+    // keyset pagination, continue right after the cursor row in (created_at, id) order. A cursor
+    // in the write log is not in memories yet, its key is bound instead.
+    if (cmd->after_id > 0 && result == 1)
+        rmbrl_sb_append_cstr(&raw_stmt, " AND (created_at, id) < (:after_created_at, :after)");
+    else if (cmd->after_id > 0)
+        rmbrl_sb_append_cstr(&raw_stmt, " AND (created_at, id) < "
+                                        "(SELECT created_at, id FROM memories WHERE id = :after)");
+    rmbrl_sb_append_cstr(&raw_stmt, " ORDER BY created_at DESC, id DESC LIMIT :limit;");
+    rmbrl_sb_append_null(&raw_stmt);
+
+    sqlite3_stmt *stmt;
+    result = rmbrl_db_prepare(db, raw_stmt.items, &stmt);
+    rmbrl_sb_free(raw_stmt);
+    if (result != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        rmbrl_wlog_end_read(db, &wlog);
+        rmbrl_wlog_free(&wlog);
+        return 1;
+    }
+
+    if (cmd->project)
+        sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":project"), cmd->project, -1,
+                          SQLITE_STATIC);
+    rmbrl_tags_bind(stmt, tags, cmd->tags_count);
+    if (cmd->after_id > 0)
+        sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":after"), cmd->after_id);
+    int after_created_at_index = sqlite3_bind_parameter_index(stmt, ":after_created_at");
+    if (after_created_at_index > 0)
+        sqlite3_bind_int64(stmt, after_created_at_index, after_created_at);
+    sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":limit"), limit);
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+    {
+        char *stmt_str = sqlite3_expanded_sql(stmt);
+        rmbrl_log(RMBRL_LOG_INFO, "Query: %s\n", stmt_str);
+        sqlite3_free(stmt_str);
+    }
+
+    // --cached missed the snapshot, put this project into it for the next prompt. A read
+    // transaction is enough, the snapshot is only written if nobody committed in the meantime.
+    bool refresh = !pending && rmbrl_command_peek_is_cacheable(cmd) &&
+                   sqlite3_exec(db, "BEGIN;", NULL, 0, NULL) == SQLITE_OK;
+    if (refresh)
+        rmbrl_snapshot_begin(db);
+
+    // both are newest first, the newer head is written until the page is full
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, cmd->format, cmd->verbosity);
+    out.changed_only = cmd->watch;
+    if (cmd->verbosity != RMBRL_VERB_SILENT && cmd->format == RMBRL_FORMAT_TEXT)
+        rmbrl_out_cstr(&out, "[INFO] Currently Remembering:\n");
+    size_t next = 0;
+    bool has_row = (result = sqlite3_step(stmt)) == SQLITE_ROW;
+    while ((has_row || next < wlog.count) && (limit < 0 || (sqlite3_int64)out.rows < limit))
+    {
+        const Rmbrl_Wlog_Record *record = next < wlog.count ? &wlog.items[next] : NULL;
+        if (record != NULL &&
+            (!has_row || record->created_at > sqlite3_column_int64(stmt, 3) ||
+             (record->created_at == sqlite3_column_int64(stmt, 3) &&
+              record->id > sqlite3_column_int64(stmt, 0))))
+        {
+            rmbrl_out_memory_fields(&out, record->id, (const unsigned char *)record->task,
+                                    record->task_size, (const unsigned char *)record->project,
+                                    record->project_size, record->created_at, 0, NULL, 0);
+            next++;
+            continue;
+        }
+        rmbrl_out_memory(&out, stmt);
+        has_row = (result = sqlite3_step(stmt)) == SQLITE_ROW;
+    }
+    if (result == SQLITE_ROW)
+        result = SQLITE_DONE;
+    rmbrl_out_end(&out);
+    rmbrl_db_release(stmt);
+
+    rmbrl_wlog_end_read(db, &wlog);
+    rmbrl_wlog_free(&wlog);
+
+    if (refresh)
+    {
+        if (result == SQLITE_DONE)
+            rmbrl_snapshot_refresh(db, cmd->project);
+        if (sqlite3_exec(db, "COMMIT;", NULL, 0, NULL) == SQLITE_OK && result == SQLITE_DONE)
+            rmbrl_snapshot_commit(db);
+    }
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    return 0;
+}
+
+// Watch
+//
+// `peek --watch` keeps its connection open and prints the page again whenever it changed, for
+// status bars that would otherwise run `rmbrl peek` every second. On Linux it sleeps in inotify
+// until the database, its WAL or the write log was written. Elsewhere, or if inotify is not
+// available, it checks PRAGMA data_version and the write log every RMBRL_WATCH_POLL_MS, neither
+// reads the database. The page is only queried again after a change, and only written if it
+// differs from the one before, see rmbrl_out_end.
+
+#ifndef RMBRL_WATCH_POLL_MS
+#define RMBRL_WATCH_POLL_MS 250
+#endif
+
+typedef struct
+{
+    int fd;           // inotify instance watching the directory of the store, -1 when polling
+    const char *name; // file name of the store, inotify reports names relative to the directory
+    int data_version;
+    char wlog_path[1024];
+    struct stat wlog_stat;
+} Rmbrl_Watch;
+
+// Returns true if name is the store or one of the files next to it that change with it.
+bool rmbrl_watch_is_store_file(const char *store, const char *name)
+{
+    size_t len = strlen(store);
+    return strncmp(name, store, len) == 0 &&
+           (name[len] == '\0' || strcmp(name + len, "-wal") == 0 ||
+            strcmp(name + len, "-wlog") == 0);
+}
+
+void rmbrl_watch_begin(Rmbrl_Watch *watch, sqlite3 *db)
+{
+    const char *db_path = sqlite3_db_filename(db, "main");
+    watch->fd = -1;
+    watch->data_version = 0;
+    rmbrl_db_query_int(db, "PRAGMA data_version;", &watch->data_version);
+    memset(&watch->wlog_stat, 0, sizeof(watch->wlog_stat));
+    if (!rmbrl_wlog_path(db_path, watch->wlog_path, sizeof(watch->wlog_path)))
+        watch->wlog_path[0] = '\0';
+    else
+        stat(watch->wlog_path, &watch->wlog_stat);
+
+#ifdef __linux__
+    const char *slash = strrchr(db_path, '/');
+    char dir[1024];
+    if (slash == NULL || (size_t)(slash - db_path) >= sizeof(dir))
+        return;
+    memcpy(dir, db_path, (size_t)(slash - db_path));
+    dir[slash - db_path] = '\0';
+    watch->name = slash + 1;
+
+    watch->fd = inotify_init1(IN_CLOEXEC);
+    if (watch->fd != -1 &&
+        inotify_add_watch(watch->fd, dir[0] == '\0' ? "/" : dir,
+                          IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_TO) == -1)
+    {
+        close(watch->fd);
+        watch->fd = -1;
+    }
+#endif // end __linux__
+}
+
+// Blocks until the store may have changed. Returns 1 on errors.
+int rmbrl_watch_wait(Rmbrl_Watch *watch, sqlite3 *db)
+{
+#ifdef __linux__
+    if (watch->fd != -1)
+    {
+        char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        for (;;)
+        {
+            ssize_t size = read(watch->fd, buf, sizeof(buf));
+            if (size == -1 && errno == EINTR)
+                continue;
+            if (size <= 0)
+                return 1;
+
+            for (char *c = buf; c < buf + size;)
+            {
+                const struct inotify_event *event = (const struct inotify_event *)c;
+                if (event->len > 0 && rmbrl_watch_is_store_file(watch->name, event->name))
+                    return 0;
+                c += sizeof(*event) + event->len;
+            }
+        }
+    }
+#endif // end __linux__
+
+    for (;;)
+    {
+        sqlite3_sleep(RMBRL_WATCH_POLL_MS);
+
+        int data_version;
+        if (!rmbrl_db_query_int(db, "PRAGMA data_version;", &data_version))
+            return 1;
+        struct stat wlog_stat = {0};
+        if (watch->wlog_path[0] != '\0')
+            stat(watch->wlog_path, &wlog_stat);
+        if (data_version != watch->data_version || wlog_stat.st_size != watch->wlog_stat.st_size ||
+            wlog_stat.st_mtime != watch->wlog_stat.st_mtime)
+        {
+            watch->data_version = data_version;
+            watch->wlog_stat = wlog_stat;
+            return 0;
+        }
+    }
+}
+
+int rmbrl_command_peek_watch(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    // watching starts before the first query, so no change after it is missed
+    Rmbrl_Watch watch;
+    rmbrl_watch_begin(&watch, db);
+    rmbrl_out_last.valid = false;
+
+    int result = 0;
+    while (result == 0)
+    {
+        result = rmbrl_command_peek(cmd, db);
+        if (result == 0)
+            result = rmbrl_watch_wait(&watch, db);
+    }
+
+#ifdef __linux__
+    if (watch.fd != -1)
+        close(watch.fd);
+#endif // end __linux__
+    return result;
+}
+
+// Turns the user's query into an FTS5 query where every whitespace separated word is a quoted
+// string, so words like "add-on" or "NOT" match literally instead of being parsed as FTS5
+// operators. Adjacent quoted strings are implicitly ANDed together.
+// Returns the number of words, 0 when the query is blank.
+size_t rmbrl_search_build_match(Rmbrl_String_Builder *sb, const char *query)
+{
+    size_t words = 0;
+    const char *c = query;
+    while (*c != '\0')
+    {
+        while (*c != '\0' && isspace((unsigned char)*c))
+            ++c;
+        if (*c == '\0')
+            break;
+
+        if (words > 0)
+            rmbrl_da_append(sb, ' ');
+        rmbrl_da_append(sb, '"');
+        for (; *c != '\0' && !isspace((unsigned char)*c); ++c)
+        {
+            if (*c == '"')
+                rmbrl_da_append(sb, '"');
+            rmbrl_da_append(sb, *c);
+        }
+        rmbrl_da_append(sb, '"');
+        ++words;
+    }
+    rmbrl_sb_append_null(sb);
+    return words;
+}
+
+int rmbrl_command_search(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (cmd->project && strlen(cmd->project) > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
+                  cmd->project);
+        return 1;
+    }
+
+    Rmbrl_String_Builder match = {0};
+    if (rmbrl_search_build_match(&match, cmd->query) == 0)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Search query is empty\n");
+        rmbrl_sb_free(match);
+        return 1;
+    }
+
+    // ORDER BY rank with a LIMIT lets FTS5 keep only the best N bm25 scores while reading the
+    // matching doclists, the memories rows are only looked up for those.
+    char *raw_stmt =
+        cmd->project
+            ? "SELECT m.id, m.task, (SELECT name FROM projects p WHERE p.id = m.project_id), "
+              "m.created_at FROM memories_fts JOIN memories m ON m.id = memories_fts.rowid "
+              "WHERE memories_fts MATCH :match AND m.archived_at IS NULL "
+              "AND m.project_id = (SELECT id FROM projects WHERE name = :project) "
+              "ORDER BY rank LIMIT :limit;"
+            : "SELECT m.id, m.task, (SELECT name FROM projects p WHERE p.id = m.project_id), "
+              "m.created_at FROM memories_fts JOIN memories m ON m.id = memories_fts.rowid "
+              "WHERE memories_fts MATCH :match AND m.archived_at IS NULL "
+              "ORDER BY rank LIMIT :limit;";
+
+    sqlite3_stmt *stmt;
+    if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        rmbrl_sb_free(match);
+        return 1;
+    }
+
+    sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":match"), match.items, -1,
+                      SQLITE_STATIC);
+    if (cmd->project)
+        sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":project"), cmd->project, -1,
+                          SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":limit"),
+                       cmd->has_limit ? cmd->limit : -1);
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+    {
+        char *stmt_str = sqlite3_expanded_sql(stmt);
+        rmbrl_log(RMBRL_LOG_INFO, "Query: %s\n", stmt_str);
+        sqlite3_free(stmt_str);
+    }
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT && cmd->format == RMBRL_FORMAT_TEXT)
+        rmbrl_log(RMBRL_LOG_INFO, "Found Memories:\n");
+
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, cmd->format, cmd->verbosity);
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+        rmbrl_out_memory(&out, stmt);
+    rmbrl_out_end(&out);
+    rmbrl_db_release(stmt);
+    rmbrl_sb_free(match);
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to search memories: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    return 0;
+}
+
+// Counts come from the projects table the triggers keep up to date, memories is not read.
+int rmbrl_command_projects(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    const char *raw_stmt = cmd->project
+                               ? "SELECT name, count FROM projects WHERE name = ? AND count > 0;"
+                               : "SELECT name, count FROM projects WHERE count > 0 ORDER BY name;";
+
+    sqlite3_stmt *stmt;
+    if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    if (cmd->project)
+        sqlite3_bind_text(stmt, 1, cmd->project, -1, SQLITE_STATIC);
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT && cmd->format == RMBRL_FORMAT_TEXT)
+        rmbrl_log(RMBRL_LOG_INFO, "Projects:\n");
+
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, cmd->format, cmd->verbosity);
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+        rmbrl_out_project(&out, stmt);
+    rmbrl_out_end(&out);
+    rmbrl_db_release(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to list projects: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    return 0;
+}
+
+// complete projects prints one name per line for shell completion. The UNIQUE index on
+// projects(name) is scanned over [prefix, successor of prefix), so only matching names are read
+// however many projects the store has.
+int rmbrl_command_complete(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    const char *prefix = cmd->prefix ? cmd->prefix : "";
+    size_t prefix_len = strlen(prefix);
+    if (prefix_len > 256)
+        return 0;
+
+    // the smallest string greater than every string starting with prefix: drop trailing 0xff
+    // bytes and increment the last one left, there is no upper bound when none is left. Memories
+    // without a project belong to "", which is never a completion.
+    char upper[257];
+    memcpy(upper, prefix, prefix_len);
+    size_t upper_len = prefix_len;
+    while (upper_len > 0 && (unsigned char)upper[upper_len - 1] == 0xff)
+        upper_len--;
+    if (upper_len > 0)
+        upper[upper_len - 1] = (char)((unsigned char)upper[upper_len - 1] + 1);
+
+    const char *raw_stmt = upper_len > 0 ? "SELECT name FROM projects "
+                                           "WHERE name >= ? AND name < ? AND count > 0 "
+                                           "ORDER BY name;"
+                                         : "SELECT name FROM projects "
+                                           "WHERE name >= ? AND name > '' AND count > 0 "
+                                           "ORDER BY name;";
+
+    sqlite3_stmt *stmt;
+    if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    sqlite3_bind_text(stmt, 1, prefix, (int)prefix_len, SQLITE_STATIC);
+    if (upper_len > 0)
+        sqlite3_bind_text(stmt, 2, upper, (int)upper_len, SQLITE_STATIC);
+
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        fwrite(sqlite3_column_text(stmt, 0), 1, (size_t)sqlite3_column_bytes(stmt, 0), stdout);
+        fputc('\n', stdout);
+    }
+    rmbrl_db_release(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to complete projects: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    return 0;
+}
+
+// Writes an age in the largest unit of --older-than that fits, e.g. 3d.
+void rmbrl_out_age(Rmbrl_Out *out, sqlite3_int64 age_ms)
+{
+    static const struct
+    {
+        char unit;
+        sqlite3_int64 ms;
+    } units[] = {{'w', 604800000}, {'d', 86400000}, {'h', 3600000}, {'m', 60000}, {'s', 1000}};
+
+    size_t i = 0;
+    while (i + 1 < sizeof(units) / sizeof(units[0]) && age_ms < units[i].ms)
+        ++i;
+    rmbrl_out_int(out, age_ms / units[i].ms);
+    rmbrl_out_write(out, &units[i].unit, 1);
+}
+
+// Every number comes from the summaries the triggers keep up to date, see v8 in rmbrl_migrations,
+// and the oldest memory is the first entry of the (created_at, id) index. No query reads more
+// rows than it shows, whatever the number of memories. db is NULL for a store that does not exist.
+int rmbrl_command_stats(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (cmd->format != RMBRL_FORMAT_TEXT && cmd->format != RMBRL_FORMAT_JSON &&
+        cmd->format != RMBRL_FORMAT_NDJSON)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Running \"stats\" supports text, json and ndjson output\n");
+        return 1;
+    }
+
+    sqlite3_int64 live = 0, added = 0, cleared = 0, oldest = 0;
+    bool has_oldest = false;
+    sqlite3_stmt *stmt;
+    int result = SQLITE_DONE;
+    bool began = false;
+    if (db != NULL)
+    {
+        // one read transaction, so every number describes the same state of the store. The one of
+        // a script already does that and is left open.
+        began = sqlite3_get_autocommit(db) &&
+                sqlite3_exec(db, "BEGIN;", NULL, 0, NULL) == SQLITE_OK;
+        const char *raw_stmt =
+            "SELECT live, added, cleared, (SELECT created_at FROM memories "
+            "WHERE archived_at IS NULL ORDER BY created_at, id LIMIT 1) FROM memory_totals;";
+        if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+            if (began)
+                sqlite3_exec(db, "COMMIT;", NULL, 0, NULL);
+            return 1;
+        }
+        result = sqlite3_step(stmt);
+        if (result == SQLITE_ROW)
+        {
+            live = sqlite3_column_int64(stmt, 0);
+            added = sqlite3_column_int64(stmt, 1);
+            cleared = sqlite3_column_int64(stmt, 2);
+            has_oldest = sqlite3_column_type(stmt, 3) != SQLITE_NULL;
+            oldest = sqlite3_column_int64(stmt, 3);
+            result = SQLITE_DONE;
+        }
+        rmbrl_db_release(stmt);
+    }
+
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    sqlite3_int64 now_ms = (sqlite3_int64)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    char timestamp[RMBRL_TIMESTAMP_SIZE];
+    rmbrl_format_timestamp(oldest, timestamp);
+    bool text = cmd->format == RMBRL_FORMAT_TEXT;
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT && text)
+        rmbrl_log(RMBRL_LOG_INFO, "Stats:\n");
+
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, text ? RMBRL_FORMAT_TEXT : RMBRL_FORMAT_NDJSON, cmd->verbosity);
+    if (text)
+    {
+        rmbrl_out_cstr(&out, "[INFO]     memories -- ");
+        rmbrl_out_int(&out, live);
+        rmbrl_out_cstr(&out, "\n[INFO]     added -- ");
+        rmbrl_out_int(&out, added);
+        rmbrl_out_cstr(&out, "\n[INFO]     cleared -- ");
+        rmbrl_out_int(&out, cleared);
+        rmbrl_out_write(&out, "\n", 1);
+        if (has_oldest)
+        {
+            rmbrl_out_cstr(&out, "[INFO]     oldest -- ");
+            rmbrl_out_write(&out, timestamp, RMBRL_TIMESTAMP_SECONDS_LEN);
+            rmbrl_out_cstr(&out, " -- ");
+            rmbrl_out_age(&out, now_ms - oldest);
+            rmbrl_out_cstr(&out, " old\n");
+        }
+    }
+    else
+    {
+        rmbrl_out_cstr(&out, "{\"memories\":");
+        rmbrl_out_int(&out, live);
+        rmbrl_out_cstr(&out, ",\"added\":");
+        rmbrl_out_int(&out, added);
+        rmbrl_out_cstr(&out, ",\"cleared\":");
+        rmbrl_out_int(&out, cleared);
+        rmbrl_out_cstr(&out, ",\"oldest\":");
+        if (has_oldest)
+        {
+            rmbrl_out_write(&out, "\"", 1);
+            rmbrl_out_write(&out, timestamp, RMBRL_TIMESTAMP_SECONDS_LEN);
+            rmbrl_out_cstr(&out, "\",\"oldest_age_ms\":");
+            rmbrl_out_int(&out, now_ms - oldest);
+        }
+        else
+        {
+            rmbrl_out_cstr(&out, "null,\"oldest_age_ms\":null");
+        }
+    }
+
+    const char *raw_stmt = cmd->project
+                               ? "SELECT name, count FROM projects WHERE name = ? AND count > 0;"
+                               : "SELECT name, count FROM projects WHERE count > 0 ORDER BY name;";
+    if (db != NULL && rmbrl_db_prepare(db, raw_stmt, &stmt) == SQLITE_OK)
+    {
+        if (cmd->project)
+            sqlite3_bind_text(stmt, 1, cmd->project, -1, SQLITE_STATIC);
+        if (text && cmd->verbosity != RMBRL_VERB_SILENT)
+            rmbrl_out_cstr(&out, "[INFO] Projects:\n");
+        else if (!text)
+            rmbrl_out_cstr(&out, ",\"projects\":[");
+        size_t rows = 0;
+        while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            if (!text && rows++ > 0)
+                rmbrl_out_write(&out, ",", 1);
+            if (!text)
+            {
+                rmbrl_out_cstr(&out, "{\"project\":");
+                rmbrl_out_json_str(&out, sqlite3_column_text(stmt, 0),
+                                   sqlite3_column_bytes(stmt, 0));
+                rmbrl_out_cstr(&out, ",\"count\":");
+                rmbrl_out_int(&out, sqlite3_column_int64(stmt, 1));
+                rmbrl_out_write(&out, "}", 1);
+            }
+            else
+            {
+                rmbrl_out_project(&out, stmt);
+            }
+        }
+        if (!text)
+            rmbrl_out_write(&out, "]", 1);
+        rmbrl_db_release(stmt);
+    }
+    else if (db != NULL)
+    {
+        result = SQLITE_ERROR;
+    }
+    else if (!text)
+    {
+        rmbrl_out_cstr(&out, ",\"projects\":[]");
+    }
+
+    sqlite3_int64 days = cmd->has_limit ? cmd->limit : cmd->all ? -1 : RMBRL_STATS_DAYS;
+    raw_stmt = "SELECT day, added, cleared FROM memory_days ORDER BY day DESC LIMIT ?;";
+    if (result == SQLITE_DONE && db != NULL && rmbrl_db_prepare(db, raw_stmt, &stmt) == SQLITE_OK)
+    {
+        sqlite3_bind_int64(stmt, 1, days);
+        if (text && cmd->verbosity != RMBRL_VERB_SILENT)
+            rmbrl_out_cstr(&out, "[INFO] Days:\n");
+        else if (!text)
+            rmbrl_out_cstr(&out, ",\"days\":[");
+        size_t rows = 0;
+        while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            rmbrl_format_timestamp(sqlite3_column_int64(stmt, 0) * 86400000, timestamp);
+            if (text)
+            {
+                rmbrl_out_cstr(&out, "[INFO]     ");
+                rmbrl_out_write(&out, timestamp, RMBRL_TIMESTAMP_DATE_LEN);
+                rmbrl_out_cstr(&out, " -- +");
+                rmbrl_out_int(&out, sqlite3_column_int64(stmt, 1));
+                rmbrl_out_cstr(&out, " -");
+                rmbrl_out_int(&out, sqlite3_column_int64(stmt, 2));
+                rmbrl_out_write(&out, "\n", 1);
+                continue;
+            }
+            if (rows++ > 0)
+                rmbrl_out_write(&out, ",", 1);
+            rmbrl_out_cstr(&out, "{\"day\":\"");
+            rmbrl_out_write(&out, timestamp, RMBRL_TIMESTAMP_DATE_LEN);
+            rmbrl_out_cstr(&out, "\",\"added\":");
+            rmbrl_out_int(&out, sqlite3_column_int64(stmt, 1));
+            rmbrl_out_cstr(&out, ",\"cleared\":");
+            rmbrl_out_int(&out, sqlite3_column_int64(stmt, 2));
+            rmbrl_out_write(&out, "}", 1);
+        }
+        if (!text)
+            rmbrl_out_write(&out, "]", 1);
+        rmbrl_db_release(stmt);
+    }
+    else if (db != NULL)
+    {
+        result = SQLITE_ERROR;
+    }
+    else if (!text)
+    {
+        rmbrl_out_cstr(&out, ",\"days\":[]");
+    }
+
+    if (!text)
+        rmbrl_out_cstr(&out, "}\n");
+    rmbrl_out_end(&out);
+
+    if (began)
+        sqlite3_exec(db, "COMMIT;", NULL, 0, NULL);
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read stats: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    return 0;
+}
+
+// Clears in a single DELETE ... RETURNING, or UPDATE ... RETURNING with --archive. The most recent
+// memory, or the N most recent with --limit, are selected by a subquery walking the
+// (project_id, created_at, id) index backwards, since SQLite only supports ORDER BY and LIMIT on
+// DELETE and UPDATE when built from its canonical source. --all and --older-than without --limit
+// forget the whole index range without a subquery. Archived memories are left to `rmbrl gc`.
+// A dry run selects the same memories in a read transaction instead, without the write lock.
+int rmbrl_command_clear(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (cmd->project && strlen(cmd->project) > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
+                  cmd->project);
+        return 1;
+    }
+
+    if (cmd->dry_run)
+        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. Memory will NOT be forgotten!\n");
+
+    // Without any selector only the most recent memory is forgotten, like peek only shows it.
+    bool latest_only = !cmd->all && !cmd->has_limit && cmd->older_than_ms == 0;
+    sqlite3_int64 limit = -1;
+    if (cmd->has_limit)
+        limit = cmd->limit;
+    else if (latest_only)
+        limit = 1;
+
+    Rmbrl_String_Builder filter = {0};
+    if (cmd->project)
+        rmbrl_sb_append_cstr(&filter,
+                             " AND project_id = (SELECT id FROM projects WHERE name = :project)");
+    if (cmd->older_than_ms > 0)
+        rmbrl_sb_append_cstr(&filter, " AND created_at < " RMBRL_SQL_NOW_MS " - :older_than");
+    rmbrl_sb_append_null(&filter);
+
+    Rmbrl_String_Builder raw_stmt = {0};
+    if (cmd->dry_run)
+    {
+        rmbrl_sb_append_cstr(&raw_stmt, "SELECT " RMBRL_MEMORY_COLUMNS
+                                        " FROM memories WHERE archived_at IS NULL");
+        rmbrl_sb_append_cstr(&raw_stmt, filter.items);
+        rmbrl_sb_append_cstr(&raw_stmt, " ORDER BY created_at DESC, id DESC LIMIT :limit;");
+    }
+    else
+    {
+        rmbrl_sb_append_cstr(&raw_stmt, cmd->archive ? "UPDATE memories SET archived_at = "
+                                                       RMBRL_SQL_NOW_MS " "
+                                                     : "DELETE FROM memories ");
+        if (limit > 0)
+        {
+            rmbrl_sb_append_cstr(&raw_stmt, "WHERE id IN "
+                                            "(SELECT id FROM memories WHERE archived_at IS NULL");
+            rmbrl_sb_append_cstr(&raw_stmt, filter.items);
+            rmbrl_sb_append_cstr(&raw_stmt, " ORDER BY created_at DESC, id DESC LIMIT :limit)");
+        }
+        else
+        {
+            rmbrl_sb_append_cstr(&raw_stmt, "WHERE archived_at IS NULL");
+            rmbrl_sb_append_cstr(&raw_stmt, filter.items);
+        }
+        rmbrl_sb_append_cstr(&raw_stmt, " RETURNING " RMBRL_MEMORY_COLUMNS ";");
+    }
+    rmbrl_sb_append_null(&raw_stmt);
+    rmbrl_sb_free(filter);
+
+    // the snapshot is refreshed inside of the same transaction, so it matches what is committed
+    if (!cmd->dry_run)
+    {
+        if (rmbrl_db_begin_transaction(db, cmd->verbosity) != 0)
+        {
+            rmbrl_sb_free(raw_stmt);
+            return 1;
+        }
+        rmbrl_snapshot_begin(db);
+    }
+
+    sqlite3_stmt *stmt;
+    int result = rmbrl_db_prepare(db, raw_stmt.items, &stmt);
+    rmbrl_sb_free(raw_stmt);
+    if (result != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        if (!cmd->dry_run)
+            rmbrl_db_rollback_transaction(db, cmd->verbosity);
+        return 1;
+    }
+
+    if (cmd->project)
+        sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":project"), cmd->project, -1,
+                          SQLITE_STATIC);
+    if (cmd->older_than_ms > 0)
+        sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":older_than"),
+                           cmd->older_than_ms);
+    int limit_index = sqlite3_bind_parameter_index(stmt, ":limit");
+    if (limit_index > 0)
+        sqlite3_bind_int64(stmt, limit_index, limit);
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+    {
+        char *stmt_str = sqlite3_expanded_sql(stmt);
+        rmbrl_log(RMBRL_LOG_INFO, "Query: %s\n", stmt_str);
+        sqlite3_free(stmt_str);
+    }
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT && cmd->format == RMBRL_FORMAT_TEXT)
+        rmbrl_log(RMBRL_LOG_INFO, "Forgotten Memories:\n");
+
+    // project of the forgotten memory, when it is the only one and --project was not given
+    char project[256 + 1] = "";
+
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, cmd->format, cmd->verbosity);
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        rmbrl_out_memory(&out, stmt);
+        if (out.rows == 1)
+            snprintf(project, sizeof(project), "%s", (const char *)sqlite3_column_text(stmt, 2));
+    }
+    rmbrl_out_end(&out);
+    rmbrl_db_release(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to forget memories: %s\n", sqlite3_errmsg(db));
+        if (!cmd->dry_run)
+            rmbrl_db_rollback_transaction(db, cmd->verbosity);
+        return 1;
+    }
+
+    if (latest_only && out.rows == 0)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "No memory to forget\n");
+        if (!cmd->dry_run)
+            rmbrl_db_rollback_transaction(db, cmd->verbosity);
+        return 1;
+    }
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "%zu memories forgotten\n", out.rows);
+
+    if (cmd->dry_run)
+        return 0;
+
+    if (cmd->project)
+    {
+        rmbrl_snapshot_refresh(db, cmd->project);
+    }
+    else if (cmd->all && cmd->older_than_ms == 0)
+    {
+        rmbrl_snapshot_forget_all();
+        rmbrl_snapshot_refresh(db, NULL);
+    }
+    else if (out.rows <= 1)
+    {
+        rmbrl_snapshot_refresh(db, project);
+    }
+    else
+    {
+        rmbrl_snapshot_refresh_all(db, false);
+    }
+
+    result = rmbrl_db_commit_transaction(db, cmd->verbosity);
+    if (result != 0)
+        return result;
+    rmbrl_snapshot_commit(db);
+
+    return 0;
+}
+
+// Purges memories archived longer ago than the retention window, then hands the freed pages back
+// to the file system. Purging runs in batches and the vacuum in steps of RMBRL_GC_VACUUM_PAGES,
+// each in its own transaction, so adds and peeks only wait for one batch or step at a time.
+int rmbrl_command_gc(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    sqlite3_int64 retention_ms = cmd->older_than_ms > 0 ? cmd->older_than_ms
+                                                        : RMBRL_DEFAULT_GC_RETENTION_MS;
+    if (cmd->all)
+        retention_ms = 0;
+
+    if (cmd->dry_run)
+    {
+        const char *raw_stmt = "SELECT count(*) FROM memories "
+                               "WHERE archived_at <= " RMBRL_SQL_NOW_MS " - ?;";
+        sqlite3_stmt *stmt;
+        if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+            return 1;
+        }
+        sqlite3_bind_int64(stmt, 1, retention_ms);
+        int result = sqlite3_step(stmt);
+        sqlite3_int64 count = result == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+        rmbrl_db_release(stmt);
+        if (result != SQLITE_ROW)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to count archived memories: %s\n",
+                      sqlite3_errmsg(db));
+            return 1;
+        }
+
+        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. %lld archived memories would be purged\n",
+                  (long long)count);
+        return 0;
+    }
+
+    const char *raw_stmt = "DELETE FROM memories WHERE id IN (SELECT id FROM memories "
+                           "WHERE archived_at <= " RMBRL_SQL_NOW_MS " - ? LIMIT ?);";
+    sqlite3_int64 purged = 0;
+    sqlite3_int64 changes;
+    do
+    {
+        if (rmbrl_db_begin_transaction(db, cmd->verbosity) != 0)
+            return 1;
+
+        sqlite3_stmt *stmt;
+        if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+            rmbrl_db_rollback_transaction(db, cmd->verbosity);
+            return 1;
+        }
+        sqlite3_bind_int64(stmt, 1, retention_ms);
+        sqlite3_bind_int64(stmt, 2, RMBRL_DEFAULT_BATCH_SIZE);
+        int result = sqlite3_step(stmt);
+        changes = sqlite3_changes64(db);
+        rmbrl_db_release(stmt);
+
+        if (result != SQLITE_DONE)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to purge archived memories: %s\n",
+                      sqlite3_errmsg(db));
+            rmbrl_db_rollback_transaction(db, cmd->verbosity);
+            return 1;
+        }
+        if (rmbrl_db_commit_transaction(db, cmd->verbosity) != 0)
+            return 1;
+        purged += changes;
+    } while (changes == RMBRL_DEFAULT_BATCH_SIZE);
+
+    // Stores created before v6 do not track free pages, VACUUM rewrites them once to switch over.
+    int auto_vacuum = 0;
+    int freed = 0;
+    char *err_msg;
+    if (!rmbrl_db_query_int(db, "PRAGMA auto_vacuum;", &auto_vacuum))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read auto vacuum mode: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    if (auto_vacuum != 2)
+    {
+        if (cmd->verbosity != RMBRL_VERB_SILENT)
+            rmbrl_log(RMBRL_LOG_INFO, "Enabling incremental vacuum, rewriting the database once\n");
+        rmbrl_db_query_int(db, "PRAGMA freelist_count;", &freed);
+        if (sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", NULL, 0, &err_msg) !=
+            SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to vacuum database: %s\n", err_msg);
+            sqlite3_free(err_msg);
+            return 1;
+        }
+    }
+    else
+    {
+        char step[64];
+        snprintf(step, sizeof(step), "PRAGMA incremental_vacuum(%d);", RMBRL_GC_VACUUM_PAGES);
+
+        int free_pages;
+        while (rmbrl_db_query_int(db, "PRAGMA freelist_count;", &free_pages) && free_pages > 0)
+        {
+            if (sqlite3_exec(db, step, NULL, 0, &err_msg) != SQLITE_OK)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Failed to vacuum database: %s\n", err_msg);
+                sqlite3_free(err_msg);
+                return 1;
+            }
+            freed += free_pages < RMBRL_GC_VACUUM_PAGES ? free_pages : RMBRL_GC_VACUUM_PAGES;
+            if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+                rmbrl_log(RMBRL_LOG_INFO, "%d free pages left\n",
+                          free_pages > RMBRL_GC_VACUUM_PAGES ? free_pages - RMBRL_GC_VACUUM_PAGES
+                                                             : 0);
+        }
+    }
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT)
+        rmbrl_log(RMBRL_LOG_INFO, "%lld archived memories purged, %d pages returned\n",
+                  (long long)purged, freed);
+
+    return 0;
+}
+
+// Backup
+//
+// `rmbrl backup` copies the store with the online backup API while other invocations keep using
+// it. The copy runs in steps of RMBRL_BACKUP_STEP_PAGES pages with a short sleep in between, all
+// inside of one read transaction: in WAL mode that never blocks adds, and the backup copies one
+// version of the store instead of starting over whenever another invocation commits. --compact
+// writes it with VACUUM INTO instead, without free pages, as a single statement. Both write next
+// to the target first and rename the finished backup over it, an interrupted backup never
+// replaces the previous one.
+//
+// `rmbrl restore` checks the backup and copies it over the store in one write transaction, readers
+// see either the memories from before or the restored ones.
+
+#ifndef RMBRL_BACKUP_STEP_PAGES
+#define RMBRL_BACKUP_STEP_PAGES 256
+#endif
+
+#ifndef RMBRL_BACKUP_STEP_SLEEP_MS
+#define RMBRL_BACKUP_STEP_SLEEP_MS 1
+#endif
+
+// Returns true if path is the file of the store, a backup must neither replace nor restore it.
+bool rmbrl_backup_is_store(sqlite3 *db, const char *path)
+{
+#ifdef _WIN32
+    return strcmp(sqlite3_db_filename(db, "main"), path) == 0;
+#else
+    struct stat store_stat, path_stat;
+    return stat(sqlite3_db_filename(db, "main"), &store_stat) == 0 &&
+           stat(path, &path_stat) == 0 && store_stat.st_dev == path_stat.st_dev &&
+           store_stat.st_ino == path_stat.st_ino;
+#endif // end _WIN32
+}
+
+// Copies the store to a new database at path in steps, see "Backup".
+int rmbrl_backup_copy(Rmbrl_Command *cmd, sqlite3 *db, const char *path)
+{
+    sqlite3 *dest = NULL;
+    if (sqlite3_open(path, &dest) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to create %s: %s\n", path, sqlite3_errmsg(dest));
+        sqlite3_close(dest);
+        return 1;
+    }
+
+    sqlite3_backup *backup = sqlite3_backup_init(dest, "main", db, "main");
+    if (backup == NULL)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to start backup: %s\n", sqlite3_errmsg(dest));
+        sqlite3_close(dest);
+        return 1;
+    }
+
+    int result;
+    while ((result = sqlite3_backup_step(backup, RMBRL_BACKUP_STEP_PAGES)) == SQLITE_OK)
+    {
+        if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "%d of %d pages left\n", sqlite3_backup_remaining(backup),
+                      sqlite3_backup_pagecount(backup));
+        // steps do not run statements, the progress handler does not see them
+        if (rmbrl_budget_remaining_ms() == 0)
+        {
+            result = SQLITE_INTERRUPT;
+            break;
+        }
+        sqlite3_sleep(RMBRL_BACKUP_STEP_SLEEP_MS);
+    }
+    sqlite3_backup_finish(backup);
+    if (result == SQLITE_DONE && sqlite3_close(dest) == SQLITE_OK)
+        return 0;
+
+    rmbrl_log(RMBRL_LOG_ERROR, "Failed to back up the store: %s\n",
+              result == SQLITE_DONE ? sqlite3_errmsg(dest) : sqlite3_errstr(result));
+    sqlite3_close(dest);
+    return 1;
+}
+
+int rmbrl_command_backup(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    char tmp_path[1024];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cmd->path) >= (int)sizeof(tmp_path))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Backup path \"%s\" is too long\n", cmd->path);
+        return 1;
+    }
+    if (rmbrl_backup_is_store(db, cmd->path))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "%s is the store itself\n", cmd->path);
+        return 1;
+    }
+
+    if (cmd->dry_run)
+    {
+        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. No backup will be written to %s!\n",
+                  cmd->path);
+        return 0;
+    }
+
+    // left behind by an interrupted backup, VACUUM INTO only writes new files
+    remove(tmp_path);
+
+    int result = 0;
+    if (cmd->compact)
+    {
+        sqlite3_stmt *stmt;
+        if (rmbrl_db_prepare(db, "VACUUM INTO ?;", &stmt) != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+            return 1;
+        }
+        sqlite3_bind_text(stmt, 1, tmp_path, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to back up the store: %s\n", sqlite3_errmsg(db));
+            result = 1;
+        }
+        rmbrl_db_release(stmt);
+    }
+    else
+    {
+        // the read transaction starts with its first read, every step then reads the same version.
+        // One that is already open is used as it is and left to whoever began it.
+        int schema_version;
+        bool began = false;
+        if (sqlite3_get_autocommit(db))
+        {
+            began = sqlite3_exec(db, "BEGIN;", NULL, 0, NULL) == SQLITE_OK;
+            result = began ? 0 : 1;
+        }
+        if (result != 0 || !rmbrl_db_query_int(db, "PRAGMA schema_version;", &schema_version))
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to read the store: %s\n", sqlite3_errmsg(db));
+            result = 1;
+        }
+        if (result == 0)
+            result = rmbrl_backup_copy(cmd, db, tmp_path);
+        if (began)
+            sqlite3_exec(db, "COMMIT;", NULL, 0, NULL);
+    }
+
+#ifdef _WIN32
+    if (result == 0 && !MoveFileExA(tmp_path, cmd->path, MOVEFILE_REPLACE_EXISTING))
+#else
+    if (result == 0 && rename(tmp_path, cmd->path) != 0)
+#endif // end _WIN32
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to write %s: %s\n", cmd->path, strerror(errno));
+        result = 1;
+    }
+    if (result != 0)
+    {
+        remove(tmp_path);
+        return 1;
+    }
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT)
+        rmbrl_log(RMBRL_LOG_INFO, "Backed up the store to %s\n", cmd->path);
+    return 0;
+}
+
+// Opens the backup at path and checks that it is an intact store this remembrall can migrate.
+int rmbrl_backup_open(const char *path, sqlite3 **backup)
+{
+    if (sqlite3_open_v2(path, backup, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to open %s: %s\n", path, sqlite3_errmsg(*backup));
+        return 1;
+    }
+
+    // prepared on the backup itself and not cached, so nothing keeps the connection open once it
+    // is closed
+    sqlite3_stmt *stmt;
+    const char *raw_stmt = "SELECT user_version, (SELECT count(*) FROM sqlite_schema "
+                           "WHERE type = 'table' AND name = 'memories') FROM pragma_user_version;";
+    if (sqlite3_prepare_v2(*backup, raw_stmt, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "%s is not a remembrall store\n", path);
+        return 1;
+    }
+    bool is_store = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 1) > 0;
+    int version = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    if (!is_store)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "%s is not a remembrall store\n", path);
+        return 1;
+    }
+    if (version > RMBRL_SCHEMA_VERSION)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR,
+                  "Backup schema v%d is newer than this remembrall supports (v%d). "
+                  "Please upgrade remembrall.\n",
+                  version, RMBRL_SCHEMA_VERSION);
+        return 1;
+    }
+
+    if (sqlite3_prepare_v2(*backup, "PRAGMA quick_check(1);", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to check %s: %s\n", path, sqlite3_errmsg(*backup));
+        return 1;
+    }
+    bool intact = sqlite3_step(stmt) == SQLITE_ROW &&
+                  strcmp((const char *)sqlite3_column_text(stmt, 0), "ok") == 0;
+    sqlite3_finalize(stmt);
+    if (!intact)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "%s is damaged, the store is left alone\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+// Closes the backup rmbrl_backup_open opened, 1 if a statement still keeps it open.
+int rmbrl_backup_close(sqlite3 *backup, const char *path)
+{
+    if (sqlite3_close(backup) == SQLITE_OK)
+        return 0;
+    rmbrl_log(RMBRL_LOG_ERROR, "Failed to close %s: %s\n", path, sqlite3_errmsg(backup));
+    return 1;
+}
+
+int rmbrl_command_restore(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (rmbrl_backup_is_store(db, cmd->path))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "%s is the store itself\n", cmd->path);
+        return 1;
+    }
+
+    sqlite3 *backup = NULL;
+    if (rmbrl_backup_open(cmd->path, &backup) != 0)
+    {
+        rmbrl_backup_close(backup, cmd->path);
+        return 1;
+    }
+
+    if (cmd->dry_run)
+    {
+        if (rmbrl_backup_close(backup, cmd->path) != 0)
+            return 1;
+        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. %s is intact, the store is NOT replaced!\n",
+                  cmd->path);
+        return 0;
+    }
+
+    // a single step copies every page in one write transaction of the store
+    sqlite3_backup *copy = sqlite3_backup_init(db, "main", backup, "main");
+    int result = copy != NULL ? sqlite3_backup_step(copy, -1) : SQLITE_ERROR;
+    if (copy != NULL)
+        sqlite3_backup_finish(copy);
+    // the store is replaced by now whether the close fails or not, the restore is finished first
+    int closed = rmbrl_backup_close(backup, cmd->path);
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to restore %s: %s\n", cmd->path,
+                  copy != NULL ? sqlite3_errstr(result) : sqlite3_errmsg(db));
+        return 1;
+    }
+
+    // an older backup is brought up to date, and the prompt snapshot starts over
+    if (rmbrl_db_migrate(db, cmd->verbosity) != 0 ||
+        rmbrl_db_begin_transaction(db, cmd->verbosity) != 0)
+        return 1;
+    rmbrl_snapshot_begin(db);
+    rmbrl_snapshot_forget_all();
+    rmbrl_snapshot_refresh_all(db, true);
+    if (rmbrl_db_commit_transaction(db, cmd->verbosity) != 0)
+        return 1;
+    rmbrl_snapshot_commit(db);
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT)
+        rmbrl_log(RMBRL_LOG_INFO, "Restored the store from %s\n", cmd->path);
+    return closed;
+}
+
+// The tags of a memory, NUL separated since a tag name never contains NUL. One lookup of the
+// memory_tags_memory_id index per memory.
+#define RMBRL_EXPORT_TAGS                                                                          \
+    "(SELECT group_concat(name, char(0)) FROM memory_tags JOIN tags ON tags.id = tag_id "          \
+    "WHERE memory_id = memories.id)"
+
+// Writes every live memory, oldest first, in a format `rmbrl import` reads back. Rows stream from
+// a single statement into the output buffer, without the milliseconds of created_at and due_at
+// or the tags getting lost.
+int rmbrl_command_export(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    const char *raw_stmt =
+        cmd->project ? "SELECT " RMBRL_MEMORY_COLUMNS ", due_at, " RMBRL_EXPORT_TAGS
+                       " FROM memories WHERE archived_at IS NULL "
+                       "AND project_id = (SELECT id FROM projects WHERE name = ?) "
+                       "ORDER BY created_at, id;"
+                     : "SELECT " RMBRL_MEMORY_COLUMNS ", due_at, " RMBRL_EXPORT_TAGS
+                       " FROM memories WHERE archived_at IS NULL ORDER BY created_at, id;";
+
+    sqlite3_stmt *stmt;
+    if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    if (cmd->project)
+        sqlite3_bind_text(stmt, 1, cmd->project, -1, SQLITE_STATIC);
+
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, cmd->format == RMBRL_FORMAT_TEXT ? RMBRL_FORMAT_NDJSON : cmd->format,
+                    cmd->verbosity);
+    out.precise = true;
+    out.due = true;
+    out.tags = true;
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+        rmbrl_out_memory(&out, stmt);
+    rmbrl_out_end(&out);
+    rmbrl_db_release(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to export memories: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "%zu memories exported\n", out.rows);
+
+    return 0;
+}
+
+// Import
+//
+// Records are parsed one at a time from the stdio buffer into fixed size buffers and inserted
+// through a single prepared statement, in transactions of --batch-size records like add --stdin.
+// Memory use does not depend on the number of records. Memories get new ids, which keeps imports
+// into a store that already has memories from clashing with them.
+
+// Longest NDJSON line, long enough for tasks and projects where every byte is escaped
+#define RMBRL_IMPORT_LINE_CAP (16 * 1024)
+
+bool rmbrl_parse_int(const char *str, sqlite3_int64 *value);
+
+typedef struct
+{
+    // -1 when the record does not have the field
+    int task_size;
+    int project_size;
+    int created_at_size;
+    int due_at_size;
+    char task[256 + 1];
+    char project[256 + 1];
+    char created_at[32];
+    char due_at[32];
+    size_t tags_count;
+    char tags[RMBRL_MAX_TAGS][256 + 1];
+} Rmbrl_Import_Record;
+
+// Parses created_at as exported, "YYYY-MM-DD HH:MM:SS" with optional milliseconds in UTC, or as a
+// number of milliseconds since the unix epoch. The "T" and "Z" of ISO 8601 are accepted too.
+bool rmbrl_parse_timestamp(const char *str, sqlite3_int64 *ms)
+{
+    bool digits = *str != '\0';
+    for (const char *c = str; *c != '\0' && digits; ++c)
+        digits = isdigit((unsigned char)*c);
+    if (digits)
+        return rmbrl_parse_int(str, ms);
+
+    int year, month, day, hour, minute, second, consumed = 0;
+    if (sscanf(str, "%4d-%2d-%2d%*1[ T]%2d:%2d:%2d%n", &year, &month, &day, &hour, &minute,
+               &second, &consumed) != 6 ||
+        consumed != 19 || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 ||
+        minute > 59 || second > 60)
+        return false;
+
+    const char *rest = str + consumed;
+    int millis = 0;
+    if (*rest == '.')
+    {
+        int scale = 100;
+        for (++rest; isdigit((unsigned char)*rest); ++rest, scale /= 10)
+            millis += (*rest - '0') * scale;
+    }
+    if (*rest == 'Z')
+        ++rest;
+    if (*rest != '\0')
+        return false;
+
+    // days_from_civil from the same source as rmbrl_format_timestamp
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    sqlite3_int64 days = (sqlite3_int64)era * 146097 + doe - 719468;
+
+    *ms = ((days * 86400 + hour * 3600 + minute * 60 + second) * 1000) + millis;
+    return true;
+}
+
+static inline const char *rmbrl_json_skip_ws(const char *c)
+{
+    while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+        ++c;
+    return c;
+}
+
+static inline int rmbrl_json_hex4(const char *c)
+{
+    int value = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        int digit = isdigit((unsigned char)c[i])            ? c[i] - '0'
+                    : (c[i] >= 'a' && c[i] <= 'f') ? c[i] - 'a' + 10
+                    : (c[i] >= 'A' && c[i] <= 'F') ? c[i] - 'A' + 10
+                                                   : -1;
+        if (digit < 0)
+            return -1;
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+// Decodes the JSON string starting at the opening quote at *c into dst, NUL terminated, and
+// advances *c past the closing quote. Returns its length in bytes, -1 if it is malformed and
+// dst_size if it does not fit.
+int rmbrl_json_parse_string(const char **c, char *dst, int dst_size)
+{
+    const char *src = *c + 1;
+    int len = 0;
+    bool overflow = false;
+    while (*src != '"')
+    {
+        char utf8[4];
+        int utf8_len = 1;
+        if ((unsigned char)*src < 0x20)
+            return -1;
+        if (*src != '\\')
+        {
+            utf8[0] = *src++;
+        }
+        else
+        {
+            ++src;
+            switch (*src)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                utf8[0] = *src;
+                break;
+            case 'b':
+                utf8[0] = '\b';
+                break;
+            case 'f':
+                utf8[0] = '\f';
+                break;
+            case 'n':
+                utf8[0] = '\n';
+                break;
+            case 'r':
+                utf8[0] = '\r';
+                break;
+            case 't':
+                utf8[0] = '\t';
+                break;
+            case 'u': {
+                long cp = rmbrl_json_hex4(src + 1);
+                if (cp < 0)
+                    return -1;
+                src += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF)
+                {
+                    // a high surrogate has to be followed by the low half of the pair
+                    int low = src[1] == '\\' && src[2] == 'u' ? rmbrl_json_hex4(src + 3) : -1;
+                    if (low < 0xDC00 || low > 0xDFFF)
+                        return -1;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    src += 6;
+                }
+                else if (cp >= 0xDC00 && cp <= 0xDFFF)
+                {
+                    return -1;
+                }
+
+                if (cp < 0x80)
+                {
+                    utf8[0] = (char)cp;
+                }
+                else if (cp < 0x800)
+                {
+                    utf8[0] = (char)(0xC0 | (cp >> 6));
+                    utf8[1] = (char)(0x80 | (cp & 0x3F));
+                    utf8_len = 2;
+                }
+                else if (cp < 0x10000)
+                {
+                    utf8[0] = (char)(0xE0 | (cp >> 12));
+                    utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    utf8[2] = (char)(0x80 | (cp & 0x3F));
+                    utf8_len = 3;
+                }
+                else
+                {
+                    utf8[0] = (char)(0xF0 | (cp >> 18));
+                    utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+                    utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    utf8[3] = (char)(0x80 | (cp & 0x3F));
+                    utf8_len = 4;
+                }
+            }
+            break;
+            default:
+                return -1;
+            }
+            ++src;
+        }
+
+        if (len + utf8_len < dst_size)
+            memcpy(dst + len, utf8, (size_t)utf8_len);
+        else
+            overflow = true;
+        len += utf8_len;
+    }
+
+    *c = src + 1;
+    dst[overflow ? 0 : len] = '\0';
+    return overflow ? dst_size : len;
+}
+
+// Parses one NDJSON line holding a flat object. task, project, created_at, due_at and the array of
+// tags are picked out, other members such as the id of an export are skipped as long as they are
+// not objects or arrays. Returns false if the line is not such an object or one of its fields is
+// too long.
+bool rmbrl_import_parse_ndjson(const char *line, Rmbrl_Import_Record *record)
+{
+    record->task_size = record->project_size = record->created_at_size = -1;
+    record->due_at_size = -1;
+    record->tags_count = 0;
+
+    const char *c = rmbrl_json_skip_ws(line);
+    if (*c++ != '{')
+        return false;
+    c = rmbrl_json_skip_ws(c);
+    while (*c != '}')
+    {
+        char key[32];
+        if (*c != '"' || rmbrl_json_parse_string(&c, key, sizeof(key)) < 0)
+            return false;
+        c = rmbrl_json_skip_ws(c);
+        if (*c++ != ':')
+            return false;
+        c = rmbrl_json_skip_ws(c);
+
+        char *dst = NULL;
+        int dst_size = 0;
+        int *size = NULL;
+        if (strcmp(key, "task") == 0)
+            dst = record->task, dst_size = sizeof(record->task), size = &record->task_size;
+        else if (strcmp(key, "project") == 0)
+            dst = record->project, dst_size = sizeof(record->project), size = &record->project_size;
+        else if (strcmp(key, "created_at") == 0)
+            dst = record->created_at, dst_size = sizeof(record->created_at),
+            size = &record->created_at_size;
+        else if (strcmp(key, "due_at") == 0)
+            dst = record->due_at, dst_size = sizeof(record->due_at), size = &record->due_at_size;
+
+        if (*c == '"')
+        {
+            char skipped[256 + 1];
+            int len = dst ? rmbrl_json_parse_string(&c, dst, dst_size)
+                          : rmbrl_json_parse_string(&c, skipped, sizeof(skipped));
+            if (len < 0 || (dst && len >= dst_size))
+                return false;
+            if (size)
+                *size = len;
+        }
+        else if (*c == '[' && strcmp(key, "tags") == 0)
+        {
+            c = rmbrl_json_skip_ws(c + 1);
+            while (*c != ']')
+            {
+                if (*c != '"' || record->tags_count == RMBRL_MAX_TAGS)
+                    return false;
+                char *tag = record->tags[record->tags_count];
+                int len = rmbrl_json_parse_string(&c, tag, sizeof(record->tags[0]));
+                if (len < 0 || len >= (int)sizeof(record->tags[0]))
+                    return false;
+                if (len > 0)
+                    record->tags_count++;
+                c = rmbrl_json_skip_ws(c);
+                if (*c == ',')
+                    c = rmbrl_json_skip_ws(c + 1);
+                else if (*c != ']')
+                    return false;
+            }
+            ++c;
+        }
+        else if (*c == '{' || *c == '[')
+        {
+            return false;
+        }
+        else
+        {
+            // numbers, true, false and null, only a number of milliseconds is kept as created_at
+            // or due_at
+            const char *start = c;
+            while (*c != '\0' && *c != ',' && *c != '}' && *c != ' ' && *c != '\t')
+                ++c;
+            int len = (int)(c - start);
+            bool null = len == 4 && memcmp(start, "null", 4) == 0;
+            if ((size == &record->created_at_size || size == &record->due_at_size) && !null)
+            {
+                if (len == 0 || len >= dst_size)
+                    return false;
+                memcpy(dst, start, (size_t)len);
+                dst[len] = '\0';
+                *size = len;
+            }
+            else if (size && !null)
+            {
+                return false;
+            }
+        }
+
+        c = rmbrl_json_skip_ws(c);
+        if (*c == ',')
+            c = rmbrl_json_skip_ws(c + 1);
+        else if (*c != '}')
+            return false;
+    }
+
+    return *rmbrl_json_skip_ws(c + 1) == '\0';
+}
+
+// Reads one RFC 4180 record from stream into buf, its fields NUL terminated one after another,
+// and points fields at the first max_fields of them. Returns the number of fields, 0 once stream
+// is exhausted, and -1 for a record that does not fit into buf or ends inside of a quoted field.
+// Either way the whole record is consumed.
+int rmbrl_csv_read_record(FILE *stream, char *buf, size_t buf_size, const char **fields,
+                          int max_fields)
+{
+    int c = getc(stream);
+    if (c == EOF)
+        return 0;
+
+    size_t len = 0;
+    int count = 0;
+    bool invalid = false;
+    for (;;)
+    {
+        if (count < max_fields)
+            fields[count] = buf + (len < buf_size ? len : buf_size - 1);
+        ++count;
+
+        if (c == '"')
+        {
+            for (;;)
+            {
+                c = getc(stream);
+                if (c == EOF)
+                {
+                    invalid = true;
+                    break;
+                }
+                if (c == '"' && (c = getc(stream)) != '"')
+                    break;
+                if (len + 1 < buf_size)
+                    buf[len++] = (char)c;
+                else
+                    invalid = true;
+            }
+        }
+        else
+        {
+            for (; c != EOF && c != ',' && c != '\n' && c != '\r'; c = getc(stream))
+            {
+                if (len + 1 < buf_size)
+                    buf[len++] = (char)c;
+                else
+                    invalid = true;
+            }
+        }
+
+        if (len < buf_size)
+            buf[len++] = '\0';
+        else
+            invalid = true;
+
+        if (c != ',')
+            break;
+        c = getc(stream);
+    }
+
+    // CRLF record ends, or whatever follows a closing quote up to the end of the line
+    while (c != EOF && c != '\n')
+    {
+        if (c != '\r')
+            invalid = true;
+        c = getc(stream);
+    }
+
+    return invalid ? -1 : count;
+}
+
+// Reads the next record in cmd->format. Returns 1 for a record, 0 once the input is exhausted and
+// -1 for a malformed record, which is skipped.
+int rmbrl_import_read(Rmbrl_Command *cmd, const int csv_columns[5], Rmbrl_Import_Record *record)
+{
+    if (cmd->format == RMBRL_FORMAT_CSV)
+    {
+        static char buf[RMBRL_IMPORT_LINE_CAP];
+        const char *fields[16];
+        int count = rmbrl_csv_read_record(cmd->input, buf, sizeof(buf), fields,
+                                          sizeof(fields) / sizeof(fields[0]));
+        if (count <= 0)
+            return count;
+
+        char *dsts[] = {record->task, record->project, record->created_at, record->due_at};
+        int *sizes[] = {&record->task_size, &record->project_size, &record->created_at_size,
+                        &record->due_at_size};
+        size_t caps[] = {sizeof(record->task), sizeof(record->project),
+                         sizeof(record->created_at), sizeof(record->due_at)};
+        for (int i = 0; i < 4; ++i)
+        {
+            *sizes[i] = -1;
+            if (csv_columns[i] < 0 || csv_columns[i] >= count ||
+                csv_columns[i] >= (int)(sizeof(fields) / sizeof(fields[0])))
+                continue;
+            size_t len = strlen(fields[csv_columns[i]]);
+            if (len >= caps[i])
+                return -1;
+            memcpy(dsts[i], fields[csv_columns[i]], len + 1);
+            *sizes[i] = (int)len;
+        }
+        // tags are separated by spaces, like they are exported
+        record->tags_count = 0;
+        int tags = csv_columns[4];
+        if (tags >= 0 && tags < count && tags < (int)(sizeof(fields) / sizeof(fields[0])))
+        {
+            for (const char *c = fields[tags]; *c != '\0';)
+            {
+                size_t len = strcspn(c, " ");
+                if (len >= sizeof(record->tags[0]) || record->tags_count == RMBRL_MAX_TAGS)
+                    return -1;
+                if (len > 0)
+                {
+                    memcpy(record->tags[record->tags_count], c, len);
+                    record->tags[record->tags_count++][len] = '\0';
+                }
+                c += len + (c[len] == ' ');
+            }
+        }
+
+        // blank lines are a single empty field
+        if (count == 1 && record->task_size <= 0)
+            record->task_size = -2;
+        return 1;
+    }
+
+    static char line[RMBRL_IMPORT_LINE_CAP];
+    long len;
+    do
+    {
+        len = rmbrl_read_record(cmd->input, '\n', line, sizeof(line));
+        if (len == -1)
+            return 0;
+    } while (len == 0 || (len == 1 && line[0] == '\r'));
+
+    if (len >= (long)sizeof(line) || !rmbrl_import_parse_ndjson(line, record))
+        return -1;
+    return 1;
+}
+
+int rmbrl_command_import(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    if (cmd->format == RMBRL_FORMAT_TEXT)
+        cmd->format = RMBRL_FORMAT_NDJSON;
+    if (cmd->format != RMBRL_FORMAT_NDJSON && cmd->format != RMBRL_FORMAT_CSV)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Import reads ndjson or csv, not %s\n",
+                  rmbrl_format_str(cmd->format));
+        return 1;
+    }
+    if (cmd->project && strlen(cmd->project) > 256)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Project \"%s\" exceeds char limit of 256 bytes.\n",
+                  cmd->project);
+        return 1;
+    }
+
+    // columns of task, project, created_at, due_at and tags, found by name in the header
+    int csv_columns[5] = {-1, -1, -1, -1, -1};
+    if (cmd->format == RMBRL_FORMAT_CSV)
+    {
+        static char header[RMBRL_IMPORT_LINE_CAP];
+        const char *fields[16];
+        int count = rmbrl_csv_read_record(cmd->input, header, sizeof(header), fields,
+                                          sizeof(fields) / sizeof(fields[0]));
+        const char *names[] = {"task", "project", "created_at", "due_at", "tags"};
+        for (int i = 0; i < count && i < (int)(sizeof(fields) / sizeof(fields[0])); ++i)
+            for (int j = 0; j < 5; ++j)
+                if (strcmp(fields[i], names[j]) == 0)
+                    csv_columns[j] = i;
+        if (csv_columns[0] < 0)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "CSV header has no task column\n");
+            return 1;
+        }
+    }
+
+    if (cmd->dry_run)
+        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. Memories will NOT be remembered!\n");
+
+    if (rmbrl_db_begin_transaction(db, cmd->verbosity) != 0)
+        return 1;
+    if (!cmd->dry_run)
+        rmbrl_snapshot_begin(db);
+
+    sqlite3_stmt *stmt;
+    const char *raw_stmt = "INSERT INTO memories (task, project_id, created_at, due_at) "
+                           "VALUES (?, ?, COALESCE(?, " RMBRL_SQL_NOW_MS "), ?);";
+    if (rmbrl_db_prepare(db, raw_stmt, &stmt) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        rmbrl_db_rollback_transaction(db, cmd->verbosity);
+        return 1;
+    }
+
+    // records usually come grouped by project, only interned again when the project changes
+    char project[256 + 1] = "";
+    sqlite3_int64 project_id = 0;
+    bool has_project_id = false;
+
+    static Rmbrl_Import_Record record;
+    size_t line = 0;
+    size_t added = 0;
+    size_t pending = 0;
+    size_t rejected = 0;
+    int result = 0;
+    int read;
+    while ((read = rmbrl_import_read(cmd, csv_columns, &record)) != 0)
+    {
+        ++line;
+        if (read == 1 && record.task_size == -2)
+            continue;
+
+        sqlite3_int64 created_at = 0;
+        sqlite3_int64 due_at = 0;
+        const char *reason = NULL;
+        if (read < 0)
+            reason = "is malformed or exceeds the char limit of 256 bytes";
+        else if (record.task_size <= 0)
+            reason = "has no task";
+        else if (record.created_at_size > 0 &&
+                 !rmbrl_parse_timestamp(record.created_at, &created_at))
+            reason = "has an invalid created_at";
+        else if (record.due_at_size > 0 && !rmbrl_parse_timestamp(record.due_at, &due_at))
+            reason = "has an invalid due_at";
+        if (reason != NULL)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Record %zu %s.\n", line, reason);
+            ++rejected;
+            continue;
+        }
+
+        const char *name = cmd->project ? cmd->project
+                           : record.project_size > 0 ? record.project
+                                                     : "";
+        if (!has_project_id || strcmp(name, project) != 0)
+        {
+            if (rmbrl_db_intern_project(db, name, &project_id) != 0)
+            {
+                result = 1;
+                break;
+            }
+            snprintf(project, sizeof(project), "%s", name);
+            has_project_id = true;
+        }
+
+        sqlite3_bind_text(stmt, 1, record.task, record.task_size, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, project_id);
+        if (record.created_at_size > 0)
+            sqlite3_bind_int64(stmt, 3, created_at);
+        else
+            sqlite3_bind_null(stmt, 3);
+        if (record.due_at_size > 0)
+            sqlite3_bind_int64(stmt, 4, due_at);
+        else
+            sqlite3_bind_null(stmt, 4);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to import record %zu: %s\n", line,
+                      sqlite3_errmsg(db));
+            result = 1;
+            break;
+        }
+        sqlite3_reset(stmt);
+
+        // interning a new tag inserts a row as well, the id of the memory is taken before
+        sqlite3_int64 memory_id = sqlite3_last_insert_rowid(db);
+        char *tags[RMBRL_MAX_TAGS];
+        sqlite3_int64 tag_ids[RMBRL_MAX_TAGS];
+        for (size_t i = 0; i < record.tags_count; ++i)
+            tags[i] = record.tags[i];
+        if (rmbrl_db_intern_tags(db, tags, record.tags_count, tag_ids) != 0 ||
+            rmbrl_db_tag_memory(db, tag_ids, record.tags_count, memory_id) != 0)
+        {
+            result = 1;
+            break;
+        }
+
+        ++pending;
+        if (!cmd->dry_run && pending == cmd->batch_size)
+        {
+            if (rmbrl_db_commit_transaction(db, cmd->verbosity) != 0 ||
+                rmbrl_db_begin_transaction(db, cmd->verbosity) != 0)
+            {
+                result = 1;
+                break;
+            }
+            added += pending;
+            pending = 0;
+        }
+    }
+    rmbrl_db_release(stmt);
+
+    if (result == 0 && ferror(cmd->input))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read stdin: %s\n", strerror(errno));
+        result = 1;
+    }
+
+    if (result != 0 || cmd->dry_run)
+    {
+        if (rmbrl_db_rollback_transaction(db, cmd->verbosity) != 0)
+            result = 1;
+    }
+    else
+    {
+        rmbrl_snapshot_refresh_all(db, true);
+        if (rmbrl_db_commit_transaction(db, cmd->verbosity) != 0)
+        {
+            result = 1;
+        }
+        else
+        {
+            added += pending;
+            rmbrl_snapshot_commit(db);
+        }
+    }
+
+    if (result != 0 && added > 0)
+        rmbrl_log(RMBRL_LOG_WARNING, "%zu memories from earlier batches were imported.\n", added);
+    else if (result == 0 && cmd->verbosity != RMBRL_VERB_SILENT)
+        rmbrl_log(RMBRL_LOG_INFO, "%zu memories were imported!\n", cmd->dry_run ? pending : added);
+
+    if (rejected > 0)
+        result = 1;
+
+    return result;
+}
+
+// Parses flags that take a value, supports "-f=value", "-f value", "--flag=value" and
+// "--flag value".
+//
+// Returns 1 and sets value if argv[*i] is the flag, *i is advanced past a separate value.
+// Returns 0 if argv[*i] is some other flag, and -1 if the flag is missing its value.
+int rmbrl_parse_flag_value(int argc, char **argv, int *i, const char *short_flag,
+                           const char *long_flag, char **value)
+{
+    const char *flags[] = {short_flag, long_flag};
+    for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f)
+    {
+        if (flags[f] == NULL)
+            continue;
+
+        size_t len = strlen(flags[f]);
+        if (strncmp(argv[*i], flags[f], len) != 0)
+            continue;
+
+        if (argv[*i][len] == '=')
+        {
+            *value = argv[*i] + len + 1;
+            return 1;
+        }
+        if (argv[*i][len] != '\0')
+            continue;
+
+        // bounds check and check value was provided
+        // ex:
+        //   correct: rmbrl peek -p name
+        //   wrong  : rmbrl peek -p --all
+        //   wrong  : rmbrl peek -p -v
+        if (*i + 1 < argc && argv[*i + 1][0] != '-')
+        {
+            *value = argv[++*i];
+            return 1;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+bool rmbrl_parse_int(const char *str, sqlite3_int64 *value)
+{
+    if (str == NULL || *str == '\0')
+        return false;
+
+    char *end;
+    errno = 0;
+    long long parsed = strtoll(str, &end, 10);
+    if (errno != 0 || *end != '\0')
+        return false;
+
+    *value = parsed;
+    return true;
+}
+
+// Parses a duration such as "90s", "15m", "12h", "30d" or "2w" into milliseconds.
+bool rmbrl_parse_duration(const char *str, sqlite3_int64 *ms)
+{
+    static const struct
+    {
+        char unit;
+        sqlite3_int64 ms;
+    } units[] = {
+        {'s', 1000}, {'m', 60 * 1000}, {'h', 60 * 60 * 1000}, {'d', 24 * 60 * 60 * 1000},
+        {'w', 7 * 24 * 60 * 60 * 1000},
+    };
+
+    if (str == NULL || *str == '\0')
+        return false;
+
+    char *end;
+    errno = 0;
+    long long parsed = strtoll(str, &end, 10);
+    if (errno != 0 || end == str || parsed < 0 || end[0] == '\0' || end[1] != '\0')
+        return false;
+
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); ++i)
+    {
+        if (units[i].unit != end[0])
+            continue;
+        if (parsed > INT64_MAX / units[i].ms)
+            return false;
+        *ms = parsed * units[i].ms;
+        return true;
+    }
+
+    return false;
+}
+
+// Parses add --due into milliseconds since the unix epoch: a duration from now such as "2d", a
+// UTC date such as "2026-10-20", which is due at its start, or a timestamp like created_at.
+bool rmbrl_parse_due(const char *str, sqlite3_int64 *ms)
+{
+    sqlite3_int64 duration;
+    if (rmbrl_parse_duration(str, &duration))
+    {
+        sqlite3_int64 now = rmbrl_now_ms();
+        if (duration > INT64_MAX - now)
+            return false;
+        *ms = now + duration;
+        return true;
+    }
+
+    char timestamp[RMBRL_TIMESTAMP_SIZE];
+    if (strlen(str) == RMBRL_TIMESTAMP_DATE_LEN)
+    {
+        snprintf(timestamp, sizeof(timestamp), "%s 00:00:00", str);
+        str = timestamp;
+    }
+    return rmbrl_parse_timestamp(str, ms) && *ms > 0;
+}
+
+// Resolves the path of the global store into db_path.
+//
+// The store defaults to the standard application data directory of the OS, which is created on
+// first use unless create_dir is false, e.g. for commands that only read. RMBRL_DB or --db
+// override it with any path SQLite accepts, including ":memory:" or a file on a tmpfs, so
+// benchmarks and tests never touch the real store.
+int rmbrl_db_global_path(char *db_path, size_t db_path_size, const char *db_override,
+                         bool create_dir)
+{
+    if (db_override == NULL || *db_override == '\0')
+        db_override = getenv("RMBRL_DB");
+    if (db_override != NULL && *db_override != '\0')
+    {
+        if (strlen(db_override) >= db_path_size)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Database path \"%s\" is too long\n", db_override);
+            return 1;
+        }
+        strcpy(db_path, db_override);
+        return 0;
+    }
+
+#ifdef _WIN32
+    char *appdata = getenv("APPDATA");
+    if (appdata == NULL)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "APPDATA environment variable not found!\n");
+        return 1;
+    }
+    snprintf(db_path, db_path_size, "%s\\rmbrl\\", appdata);
+    int result = create_dir ? mkdir(db_path) : 0;
+#elif defined(__APPLE__) && defined(__MACH__)
+
+    char *home_env = getenv("HOME");
+    if (home_env == NULL)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "HOME environment variable not found!\n");
+        return 1;
+    }
+    snprintf(db_path, db_path_size, "%s/Library/Application Support/rmbrl/", home_env);
+    int result = create_dir ? mkdir(db_path, 0755) : 0;
+#elif defined(__linux__)
+    char *home_env = getenv("HOME");
+    if (home_env == NULL)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "HOME environment variable not found!\n");
+        return 1;
+    }
+    snprintf(db_path, db_path_size, "%s/.local/share/rmbrl/", home_env);
+    int result = create_dir ? mkdir(db_path, 0755) : 0;
+#else
+    rmbrl_log(RMBRL_LOG_ERROR, "Running on an unknown operating system.\n");
+    return 1;
+#endif
+
+    // NOTE: db_path will already exist if user provided --install flag when building remembrall
+    if (result == -1 && errno != EEXIST)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to create path: %s\nReason: %s\n", db_path,
+                  strerror(errno));
+        return 1;
+    }
+    strncat(db_path, "rmbrl.db", db_path_size - strlen(db_path) - 1);
+
+    return 0;
+}
+
+// Repository stores
+//
+// A repository can keep its memories in a store of its own, `rmbrl init` creates ".rmbrl.db" in
+// the current directory. Every command run in that directory or below it uses the nearest such
+// store instead of the global one, unless --db or RMBRL_DB point somewhere else. Stores stay
+// small and prompts in different repositories never wait on each other's writes.
+//
+// `rmbrl init` also lists the store in "rmbrl.db-stores" next to the global store, one path per
+// line. `peek --global` attaches every listed store to one connection and merges their memories.
+
+#define RMBRL_REPO_STORE_NAME ".rmbrl.db"
+
+// The default SQLITE_MAX_ATTACHED is 10, the build raises it to its maximum of 125
+#define RMBRL_GLOBAL_MAX_STORES 125
+
+bool rmbrl_path_is_separator(char c)
+{
+#ifdef _WIN32
+    return c == '\\' || c == '/';
+#else
+    return c == '/';
+#endif // end _WIN32
+}
+
+// Looks for RMBRL_REPO_STORE_NAME in the current directory and each of its parents, a handful of
+// stat calls for a typical checkout.
+bool rmbrl_db_find_repo_store(char *db_path, size_t db_path_size)
+{
+    char dir[1024];
+#ifdef _WIN32
+    if (_getcwd(dir, sizeof(dir)) == NULL)
+        return false;
+#else
+    if (getcwd(dir, sizeof(dir)) == NULL)
+        return false;
+#endif // end _WIN32
+
+    size_t len = strlen(dir);
+    for (;;)
+    {
+        bool separated = len > 0 && rmbrl_path_is_separator(dir[len - 1]);
+        int written = snprintf(db_path, db_path_size, "%.*s%s" RMBRL_REPO_STORE_NAME, (int)len,
+                               dir, separated ? "" : "/");
+        struct stat st;
+        if (written > 0 && (size_t)written < db_path_size && stat(db_path, &st) == 0 &&
+            (st.st_mode & S_IFMT) == S_IFREG)
+            return true;
+
+        // strip the last component, the root keeps its separator and ends the walk
+        size_t parent = len;
+        while (parent > 0 && !rmbrl_path_is_separator(dir[parent - 1]))
+            --parent;
+        while (parent > 1 && rmbrl_path_is_separator(dir[parent - 1]))
+            --parent;
+        if (parent == 0 || parent >= len)
+            return false;
+        len = parent;
+    }
+}
+
+// Resolves the path of the store a command runs on into db_path: --db or RMBRL_DB, the nearest
+// repository store, or the global store.
+int rmbrl_db_path(char *db_path, size_t db_path_size, const char *db_override,
+                  bool create_dir)
+{
+    if (db_override == NULL || *db_override == '\0')
+        db_override = getenv("RMBRL_DB");
+    if ((db_override == NULL || *db_override == '\0') &&
+        rmbrl_db_find_repo_store(db_path, db_path_size))
+        return 0;
+    return rmbrl_db_global_path(db_path, db_path_size, db_override, create_dir);
+}
+
+// SQLite memory
+//
+// SQLite allocates from static buffers instead of malloc: memsys5 over a fixed heap, a page cache
+// for the default 4KiB pages and lookaside slots for the connection's small, short-lived
+// allocations. What an invocation can allocate is bounded by the buffers, and for `rmbrl serve`
+// memory stops growing after the first few requests. Large imports and clears that need more
+// than the heap fail with "out of memory" and roll back, RMBRL_SQLITE_HEAP_SIZE raises the limit.
+
+#define RMBRL_SQLITE_PAGE_SIZE 4096
+#define RMBRL_SQLITE_PAGECACHE_HEADER 384 // SQLite needs 272 bytes on 64-bit targets
+#define RMBRL_SQLITE_PAGECACHE_SLOT (RMBRL_SQLITE_PAGE_SIZE + RMBRL_SQLITE_PAGECACHE_HEADER)
+#define RMBRL_SQLITE_LOOKASIDE_SLOT 1200
+#define RMBRL_SQLITE_LOOKASIDE_SLOTS 64
+
+#if RMBRL_SQLITE_HEAP_SIZE > 0
+static Rmbrl_Align rmbrl_sqlite_heap[RMBRL_SQLITE_HEAP_SIZE / sizeof(Rmbrl_Align)];
+static Rmbrl_Align rmbrl_sqlite_pagecache[RMBRL_SQLITE_PAGECACHE_SLOT *
+                                          RMBRL_SQLITE_PAGECACHE_PAGES / sizeof(Rmbrl_Align)];
+static Rmbrl_Align rmbrl_sqlite_lookaside[RMBRL_SQLITE_LOOKASIDE_SLOT *
+                                          RMBRL_SQLITE_LOOKASIDE_SLOTS / sizeof(Rmbrl_Align)];
+#endif
+
+// Has to run before anything else calls into SQLite. Failures are not fatal, SQLite then keeps
+// using malloc for whatever could not be configured.
+void rmbrl_sqlite_configure(void)
+{
+#if RMBRL_SQLITE_HEAP_SIZE > 0
+    if (sqlite3_config(SQLITE_CONFIG_HEAP, rmbrl_sqlite_heap, (int)sizeof(rmbrl_sqlite_heap),
+                       64) != SQLITE_OK)
+        return;
+
+    int header_size = 0;
+    if (sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &header_size) == SQLITE_OK &&
+        header_size <= RMBRL_SQLITE_PAGECACHE_HEADER)
+        sqlite3_config(SQLITE_CONFIG_PAGECACHE, rmbrl_sqlite_pagecache,
+                       RMBRL_SQLITE_PAGECACHE_SLOT, RMBRL_SQLITE_PAGECACHE_PAGES);
+
+    // rmbrl_db_open hands the connection the static lookaside buffer instead
+    sqlite3_config(SQLITE_CONFIG_LOOKASIDE, 0, 0);
+
+    if (RMBRL_SQLITE_SOFT_HEAP_LIMIT > 0)
+    {
+        sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 1);
+        sqlite3_soft_heap_limit64(RMBRL_SQLITE_SOFT_HEAP_LIMIT);
+    }
+#endif
+}
+
+// Opens the store for concurrent use by several invocations.
+//
+// WAL lets peeks in prompts read while hooks add, readers never block the writer and the writer
+// never blocks readers. With synchronous=NORMAL a commit only appends to the WAL without an fsync,
+// the main database is only synced by checkpoints. The checkpoint SQLite runs when the last
+// connection closes is disabled so an add does not pay for one every time, rmbrl_db_close does it
+// once enough commits piled up instead.
+int rmbrl_db_open(const char *db_path, Rmbrl_Command *cmd, sqlite3 **db)
+{
+    if (sqlite3_open(db_path, db) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Databased connection failed: %s\n", sqlite3_errmsg(*db));
+        return 1;
+    }
+
+#if RMBRL_SQLITE_HEAP_SIZE > 0
+    sqlite3_db_config(*db, SQLITE_DBCONFIG_LOOKASIDE, rmbrl_sqlite_lookaside,
+                      RMBRL_SQLITE_LOOKASIDE_SLOT, RMBRL_SQLITE_LOOKASIDE_SLOTS);
+#endif
+
+    rmbrl_busy.timeout_ms = cmd->busy_timeout_ms;
+    sqlite3_busy_handler(*db, rmbrl_db_busy_handler, &rmbrl_busy);
+    rmbrl_db_set_budget(*db);
+    sqlite3_db_config(*db, SQLITE_DBCONFIG_NO_CKPT_ON_CLOSE, 1, NULL);
+
+    // auto_vacuum only takes effect on a new store and has to come before switching it to WAL,
+    // which writes the header. Existing stores are switched over by `rmbrl gc`, setting it on them
+    // would rewrite their first page in a write transaction on every open.
+    int page_count = 0;
+    const char *raw_stmt = "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;";
+    if (rmbrl_db_query_int(*db, "PRAGMA page_count;", &page_count) && page_count == 0)
+        raw_stmt = "PRAGMA auto_vacuum = INCREMENTAL; PRAGMA journal_mode = WAL; "
+                   "PRAGMA synchronous = NORMAL;";
+
+    char *err_msg;
+    if (sqlite3_exec(*db, raw_stmt, NULL, 0, &err_msg) != SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to configure database: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return 1;
+    }
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "Database connection successful!\n");
+
+    return 0;
+}
+
+// Opens the store for a command that only reads it. Nothing is written: no schema migration, no
+// journal mode switch and no write lock, the connection reads the WAL like any other reader.
+// Returns 1 without logging an error if the store needs the read-write path instead, because its
+// schema is older than this remembrall or the WAL index cannot be read without writing it.
+int rmbrl_db_open_read_only(const char *db_path, Rmbrl_Command *cmd, sqlite3 **db)
+{
+    if (sqlite3_open_v2(db_path, db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(*db);
+        *db = NULL;
+        return 1;
+    }
+
+#if RMBRL_SQLITE_HEAP_SIZE > 0
+    sqlite3_db_config(*db, SQLITE_DBCONFIG_LOOKASIDE, rmbrl_sqlite_lookaside,
+                      RMBRL_SQLITE_LOOKASIDE_SLOT, RMBRL_SQLITE_LOOKASIDE_SLOTS);
+#endif
+
+    rmbrl_busy.timeout_ms = cmd->busy_timeout_ms;
+    sqlite3_busy_handler(*db, rmbrl_db_busy_handler, &rmbrl_busy);
+    rmbrl_db_set_budget(*db);
+
+    int version = 0;
+    if (!rmbrl_db_query_int(*db, "PRAGMA user_version;", &version) ||
+        version != RMBRL_SCHEMA_VERSION)
+    {
+        if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "Read-only open not possible, opening read-write\n");
+        rmbrl_db_finalize_cached();
+        sqlite3_close(*db);
+        *db = NULL;
+        return 1;
+    }
+
+    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "Database connection successful! (read-only)\n");
+
+    return 0;
+}
+
+void rmbrl_db_close(sqlite3 *db)
+{
+    if (db == NULL)
+        return;
+
+    rmbrl_db_truncate_wal(db);
+    rmbrl_db_finalize_cached();
+    sqlite3_close(db);
+}
+
+// Folds the log of the store at db_path once add made it outgrow RMBRL_WLOG_FOLD_BYTES. The memory
+// is safe in the log already, failing to fold only leaves that to the next command.
+void rmbrl_wlog_fold_store(const char *db_path, Rmbrl_Command *cmd)
+{
+    sqlite3 *db = NULL;
+    size_t folded;
+    if (rmbrl_db_open(db_path, cmd, &db) != 0 || rmbrl_db_migrate(db, cmd->verbosity) != 0 ||
+        rmbrl_wlog_fold(db, cmd->verbosity, &folded) != 0)
+        rmbrl_log(RMBRL_LOG_WARNING, "The write log is folded by the next command instead\n");
+    rmbrl_db_close(db);
+}
+
+// Adds store_path to the list of repository stores next to the global store, unless it is listed.
+int rmbrl_stores_register(const char *global_path, const char *store_path)
+{
+    char list_path[1024];
+    if (snprintf(list_path, sizeof(list_path), "%s-stores", global_path) >=
+        (int)sizeof(list_path))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Database path \"%s\" is too long\n", global_path);
+        return 1;
+    }
+
+    FILE *list = fopen(list_path, "a+");
+    if (list == NULL)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to open %s: %s\n", list_path, strerror(errno));
+        return 1;
+    }
+
+    char line[1024];
+    long len;
+    bool listed = false;
+    while (!listed && (len = rmbrl_read_record(list, '\n', line, sizeof(line))) != -1)
+        listed = len < (long)sizeof(line) && strcmp(line, store_path) == 0;
+
+    int result = 0;
+    if (!listed && fprintf(list, "%s\n", store_path) < 0)
+        result = 1;
+    if (fclose(list) != 0)
+        result = 1;
+    if (result != 0)
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to write %s: %s\n", list_path, strerror(errno));
+    return result;
+}
+
+// Creates a repository store in the current directory and registers it for `peek --global`.
+int rmbrl_command_init(Rmbrl_Command *cmd)
+{
+    char cwd[1024];
+    char store_path[1024 + sizeof(RMBRL_REPO_STORE_NAME) + 1];
+#ifdef _WIN32
+    bool found_cwd = _getcwd(cwd, sizeof(cwd)) != NULL;
+#else
+    bool found_cwd = getcwd(cwd, sizeof(cwd)) != NULL;
+#endif // end _WIN32
+    if (!found_cwd)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to get the current directory: %s\n", strerror(errno));
+        return 1;
+    }
+    size_t cwd_len = strlen(cwd);
+    snprintf(store_path, sizeof(store_path), "%s%s" RMBRL_REPO_STORE_NAME, cwd,
+             cwd_len > 0 && rmbrl_path_is_separator(cwd[cwd_len - 1]) ? "" : "/");
+
+    char global_path[512];
+    if (rmbrl_db_global_path(global_path, sizeof(global_path), cmd->db_override, true) != 0)
+        return 1;
+
+    if (cmd->dry_run)
+    {
+        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. %s will NOT be created!\n", store_path);
+        return 0;
+    }
+
+    sqlite3 *db = NULL;
+    int result = 0;
+    if (rmbrl_db_open(store_path, cmd, &db) != 0 || rmbrl_db_migrate(db, cmd->verbosity) != 0 ||
+        rmbrl_stores_register(global_path, store_path) != 0)
+        result = 1;
+    rmbrl_db_close(db);
+
+    if (result == 0 && cmd->verbosity != RMBRL_VERB_SILENT)
+        rmbrl_log(RMBRL_LOG_INFO, "Memories of this directory now live in %s\n", store_path);
+    return result;
+}
+
+// Attaches path read-only as schema. SQLite needs a URI for that, so characters with a meaning in
+// URIs are percent-encoded.
+int rmbrl_db_attach_read_only(sqlite3 *db, const char *path, const char *schema)
+{
+    char uri[3 * 1024 + 32] = "file:";
+    size_t len = strlen(uri);
+#ifdef _WIN32
+    // drive letters need an empty authority, "file:///C:/..."
+    if (isalpha((unsigned char)path[0]) && path[1] == ':')
+        len += (size_t)snprintf(uri + len, sizeof(uri) - len, "///");
+#endif // end _WIN32
+    for (const char *c = path; *c != '\0'; ++c)
+    {
+        if (len + 16 >= sizeof(uri))
+            return SQLITE_TOOBIG;
+        if (*c == '%' || *c == '?' || *c == '#')
+            len += (size_t)snprintf(uri + len, sizeof(uri) - len, "%%%02X", (unsigned char)*c);
+        else
+            uri[len++] = rmbrl_path_is_separator(*c) ? '/' : *c;
+    }
+    snprintf(uri + len, sizeof(uri) - len, "?mode=ro");
+
+    sqlite3_stmt *stmt;
+    int result = sqlite3_prepare_v2(db, "ATTACH DATABASE ? AS ?;", -1, &stmt, NULL);
+    if (result != SQLITE_OK)
+        return result;
+    sqlite3_bind_text(stmt, 1, uri, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, schema, -1, SQLITE_STATIC);
+    result = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    return result == SQLITE_DONE ? SQLITE_OK : result;
+}
 
-    if (result != SQLITE_DONE)
+typedef struct
+{
+    sqlite3_stmt *stmt; // positioned on the store's next memory
+    sqlite3_int64 created_at;
+    sqlite3_int64 id;
+    int store;
+} Rmbrl_Merge_Cursor;
+
+// Newest first, ties are broken by id and then by the order of the stores.
+static inline bool rmbrl_merge_before(const Rmbrl_Merge_Cursor *a, const Rmbrl_Merge_Cursor *b)
+{
+    if (a->created_at != b->created_at)
+        return a->created_at > b->created_at;
+    if (a->id != b->id)
+        return a->id > b->id;
+    return a->store < b->store;
+}
+
+void rmbrl_merge_sift_down(Rmbrl_Merge_Cursor *heap, size_t count, size_t i)
+{
+    for (;;)
     {
-        rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember: %s\n", sqlite3_errmsg(db));
-        return 1;
+        size_t first = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < count && rmbrl_merge_before(&heap[left], &heap[first]))
+            first = left;
+        if (right < count && rmbrl_merge_before(&heap[right], &heap[first]))
+            first = right;
+        if (first == i)
+            return;
+        Rmbrl_Merge_Cursor tmp = heap[i];
+        heap[i] = heap[first];
+        heap[first] = tmp;
+        i = first;
     }
+}
 
-    return 0;
+// Steps the cursor, returns false once its store has no more memories.
+bool rmbrl_merge_step(Rmbrl_Merge_Cursor *cursor, int *result)
+{
+    *result = sqlite3_step(cursor->stmt);
+    if (*result != SQLITE_ROW)
+        return false;
+    cursor->id = sqlite3_column_int64(cursor->stmt, 0);
+    cursor->created_at = sqlite3_column_int64(cursor->stmt, 3);
+    return true;
 }
 
-int rmbrl_command_clear(Rmbrl_Command *cmd, sqlite3 *db)
+// peek --global. The global store, the repository store of the current directory and every
+// registered repository store are attached read-only to one in-memory connection. Each store is
+// queried through its own (created_at, id) index, newest first and at most limit memories, and
+// the streams are merged with a binary heap keyed on the head of each. Only limit rows are ever
+// read from a store and a single read transaction makes the view consistent across them.
+int rmbrl_command_peek_global(Rmbrl_Command *cmd)
 {
     if (cmd->project && strlen(cmd->project) > 256)
     {
@@ -414,145 +6206,839 @@ int rmbrl_command_clear(Rmbrl_Command *cmd, sqlite3 *db)
                   cmd->project);
         return 1;
     }
+    if (cmd->after_id > 0)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Ids are per store, --after does not work with --global\n");
+        return 1;
+    }
 
-    if (cmd->dry_run)
+    sqlite3_int64 limit = -1;
+    if (cmd->has_limit)
+        limit = cmd->limit;
+    else if (!cmd->all)
+        limit = 1;
+
+    static char paths[RMBRL_GLOBAL_MAX_STORES][1024];
+    size_t path_count = 0;
+    if (rmbrl_db_global_path(paths[0], sizeof(paths[0]), cmd->db_override, false) != 0)
+        return 1;
+    path_count = 1;
+    if ((cmd->db_override == NULL || *cmd->db_override == '\0') &&
+        rmbrl_db_find_repo_store(paths[1], sizeof(paths[1])))
+        path_count = 2;
+
+    char list_path[1024];
+    FILE *list = NULL;
+    if (snprintf(list_path, sizeof(list_path), "%s-stores", paths[0]) < (int)sizeof(list_path))
+        list = fopen(list_path, "r");
+    long len;
+    while (list != NULL && path_count < RMBRL_GLOBAL_MAX_STORES &&
+           (len = rmbrl_read_record(list, '\n', paths[path_count], sizeof(paths[0]))) != -1)
     {
-        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. Memory will NOT be forgotten!\n");
-        int result = rmbrl_db_begin_transaction(db, cmd->verbosity);
-        if (result != 0)
-            return result;
+        if (len == 0 || len >= (long)sizeof(paths[0]))
+            continue;
+        bool listed = false;
+        for (size_t i = 0; i < path_count && !listed; ++i)
+            listed = strcmp(paths[i], paths[path_count]) == 0;
+        if (!listed)
+            ++path_count;
+    }
+    if (list != NULL)
+    {
+        if (path_count == RMBRL_GLOBAL_MAX_STORES && !feof(list))
+            rmbrl_log(RMBRL_LOG_WARNING, "Only the first %d stores of %s are shown\n",
+                      RMBRL_GLOBAL_MAX_STORES, list_path);
+        fclose(list);
     }
 
-    int id = -1;
-    sqlite3_stmt *stmt;
-    char *raw_stmt;
+    sqlite3 *db = NULL;
+    if (sqlite3_open_v2(":memory:", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_URI, NULL) !=
+        SQLITE_OK)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Databased connection failed: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return 1;
+    }
+    rmbrl_busy.timeout_ms = cmd->busy_timeout_ms;
+    sqlite3_busy_handler(db, rmbrl_db_busy_handler, &rmbrl_busy);
+    rmbrl_db_set_budget(db);
 
-    // not clearing all forgotten items, have to retrieve id first before deleting.
-    if (!cmd->all)
+    static Rmbrl_Merge_Cursor heap[RMBRL_GLOBAL_MAX_STORES];
+    size_t count = 0;
+    int result = SQLITE_OK;
+    for (size_t i = 0; i < path_count; ++i)
     {
-        if (cmd->project)
-            raw_stmt = "SELECT * FROM memories WHERE project = ? ORDER BY created_at DESC LIMIT 1;";
-        else
-            raw_stmt = "SELECT * FROM memories ORDER BY created_at DESC LIMIT 1";
+        struct stat st;
+        if (stat(paths[i], &st) != 0)
+            continue;
 
-        if (sqlite3_prepare_v2(db, raw_stmt, -1, &stmt, NULL) != SQLITE_OK)
+        char schema[32];
+        snprintf(schema, sizeof(schema), "s%zu", i);
+        result = rmbrl_db_attach_read_only(db, paths[i], schema);
+        if (result == SQLITE_OK)
         {
-            rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-            return 1;
+            char raw_stmt[512];
+            snprintf(raw_stmt, sizeof(raw_stmt), "PRAGMA %s.user_version;", schema);
+            int version = 0;
+            sqlite3_stmt *stmt;
+            if (sqlite3_prepare_v2(db, raw_stmt, -1, &stmt, NULL) == SQLITE_OK &&
+                sqlite3_step(stmt) == SQLITE_ROW)
+                version = sqlite3_column_int(stmt, 0);
+            sqlite3_finalize(stmt);
+            if (version != RMBRL_SCHEMA_VERSION)
+            {
+                rmbrl_log(RMBRL_LOG_WARNING,
+                          "Skipping %s, its schema is v%d, run any rmbrl command on it to "
+                          "migrate it to v%d\n",
+                          paths[i], version, RMBRL_SCHEMA_VERSION);
+                continue;
+            }
+
+            char project_clause[128] = "";
+            if (cmd->project)
+                snprintf(project_clause, sizeof(project_clause),
+                         " AND project_id = (SELECT id FROM %s.projects WHERE name = ?)", schema);
+            snprintf(raw_stmt, sizeof(raw_stmt),
+                     "SELECT id, task, (SELECT name FROM %s.projects "
+                     "WHERE projects.id = project_id), created_at FROM %s.memories "
+                     "WHERE archived_at IS NULL%s ORDER BY created_at DESC, id DESC LIMIT ?;",
+                     schema, schema, project_clause);
+            result = sqlite3_prepare_v2(db, raw_stmt, -1, &heap[count].stmt, NULL);
+        }
+        if (result != SQLITE_OK)
+        {
+            rmbrl_log(RMBRL_LOG_WARNING, "Skipping %s: %s\n", paths[i], sqlite3_errmsg(db));
+            result = SQLITE_OK;
+            continue;
         }
 
+        heap[count].store = (int)i;
+        count++;
+    }
+    if (count > 0)
+        sqlite3_exec(db, "BEGIN;", NULL, 0, NULL);
+
+    if (cmd->verbosity != RMBRL_VERB_SILENT && cmd->format == RMBRL_FORMAT_TEXT)
+        rmbrl_log(RMBRL_LOG_INFO, "Currently Remembering:\n");
+
+    // heap[0..active) holds the cursors that still have memories, the rest are kept to finalize
+    size_t active = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int param = 1;
         if (cmd->project)
-            sqlite3_bind_text(stmt, 1, cmd->project, -1, SQLITE_STATIC);
+            sqlite3_bind_text(heap[i].stmt, param++, cmd->project, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(heap[i].stmt, param, limit);
 
-        if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+        Rmbrl_Merge_Cursor cursor = heap[i];
+        int step;
+        if (rmbrl_merge_step(&cursor, &step))
         {
-            char *stmt_str = sqlite3_expanded_sql(stmt);
-            rmbrl_log(RMBRL_LOG_INFO, "Query: %s\n", stmt_str);
+            heap[i] = heap[active];
+            heap[active++] = cursor;
         }
-
-        int result = sqlite3_step(stmt);
-        if (result == SQLITE_DONE)
+        else if (step != SQLITE_DONE)
         {
-            sqlite3_finalize(stmt);
-            rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember memory to delete: %s\n",
-                      sqlite3_errmsg(db));
-            return 1;
+            result = step;
         }
+    }
+    for (size_t i = active; i-- > 0;)
+        rmbrl_merge_sift_down(heap, active, i);
 
-        id = sqlite3_column_int(stmt, 0);
-        if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, cmd->format, cmd->verbosity);
+    while (active > 0 && result == SQLITE_OK && (limit < 0 || (sqlite3_int64)out.rows < limit))
+    {
+        // ids are per store, the store tells memories with the same id apart
+        out.store = paths[heap[0].store];
+        rmbrl_out_memory(&out, heap[0].stmt);
+
+        int step;
+        if (!rmbrl_merge_step(&heap[0], &step))
         {
-            rmbrl_log(RMBRL_LOG_INFO, "Found Memory:\n");
-            const unsigned char *task = sqlite3_column_text(stmt, 1);
-            rmbrl_log(RMBRL_LOG_INFO, "    \"%s\"", task);
+            if (step != SQLITE_DONE)
+                result = step;
+            Rmbrl_Merge_Cursor done = heap[0];
+            heap[0] = heap[--active];
+            heap[active] = done;
+        }
+        rmbrl_merge_sift_down(heap, active, 0);
+    }
+    rmbrl_out_end(&out);
+
+    if (result != SQLITE_OK)
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to remember: %s\n", sqlite3_errmsg(db));
+
+    for (size_t i = 0; i < count; ++i)
+        sqlite3_finalize(heap[i].stmt);
+    sqlite3_close(db);
+    return result == SQLITE_OK ? 0 : 1;
+}
+
+int rmbrl_run(int argc, char **argv, sqlite3 *served_db, FILE *input);
+
+// Script mode
+//
+// `rmbrl exec` reads one command per line, e.g. `add "fix the build" -p lazypm`, and runs them
+// in order on one connection and statement cache, inside of a single transaction. The first
+// command that fails stops the script and rolls all of it back, --dry-run rolls it back at the
+// end. Commands are parsed like arguments of the shell: words are separated by whitespace, single
+// quotes keep everything up to the next one, double quotes and backslashes escape like in sh.
+// Blank lines and lines starting with # are skipped, a leading "rmbrl" is optional.
 
-            const char *project = (char *)sqlite3_column_text(stmt, 2);
-            if (strlen(project) > 0)
-                fprintf(stderr, " -- %s", project);
+#define RMBRL_SCRIPT_LINE_CAP 4096
+#define RMBRL_SCRIPT_MAX_ARGS 64
 
-            char *created_at = rmbrl_strdup((char *)sqlite3_column_text(stmt, 3));
-            created_at[10] = '\0';
-            fprintf(stderr, " -- %s", created_at);
-            RMBRL_FREE(created_at);
+// Splits line into words in place, argv[0] is left for the program name. Returns the number of
+// entries in argv, or -1 for an unterminated quote or too many words.
+int rmbrl_script_split(char *line, char **argv, int max_args)
+{
+    int argc = 1;
+    char *src = line;
+    char *dst = line;
+    for (;;)
+    {
+        while (*src == ' ' || *src == '\t' || *src == '\r')
+            ++src;
+        if (*src == '\0' || (argc == 1 && *src == '#'))
+            break;
+        if (argc == max_args)
+            return -1;
 
-            fprintf(stderr, "\n");
+        argv[argc++] = dst;
+        while (*src != '\0' && *src != ' ' && *src != '\t' && *src != '\r')
+        {
+            if (*src == '\'')
+            {
+                for (++src; *src != '\''; ++src)
+                {
+                    if (*src == '\0')
+                        return -1;
+                    *dst++ = *src;
+                }
+                ++src;
+            }
+            else if (*src == '"')
+            {
+                for (++src; *src != '"'; ++src)
+                {
+                    if (*src == '\0')
+                        return -1;
+                    if (*src == '\\' && (src[1] == '"' || src[1] == '\\' || src[1] == '$' ||
+                                          src[1] == '`'))
+                        ++src;
+                    *dst++ = *src;
+                }
+                ++src;
+            }
+            else
+            {
+                if (*src == '\\' && src[1] != '\0')
+                    ++src;
+                *dst++ = *src++;
+            }
         }
-        sqlite3_finalize(stmt);
+
+        // dst never passes src, so terminating the word cannot overwrite what is left to split
+        bool end = *src == '\0';
+        *dst++ = '\0';
+        if (end)
+            break;
+        ++src;
     }
+    return argc;
+}
 
-    if (id == -1)
+int rmbrl_command_exec(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    FILE *script = cmd->input;
+    if (strcmp(cmd->script, "-") != 0)
     {
-        if (cmd->project)
-            raw_stmt = "DELETE FROM memories WHERE project = ? RETURNING *;";
+        script = fopen(cmd->script, "r");
+        if (script == NULL)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to open script %s: %s\n", cmd->script,
+                      strerror(errno));
+            return 1;
+        }
+    }
+
+    if (cmd->dry_run)
+        rmbrl_log(RMBRL_LOG_INFO, "Performing dry run. The script will be rolled back!\n");
+
+    int result = rmbrl_db_begin_transaction(db, cmd->verbosity);
+    rmbrl_script.active = result == 0;
+
+    // every command resets the stats for itself, the script reports its own once they ran
+    Rmbrl_Stats stats = rmbrl_stats;
+
+    static char line[RMBRL_SCRIPT_LINE_CAP];
+    size_t commands = 0;
+    long len;
+    for (size_t line_number = 1; result == 0; ++line_number)
+    {
+        len = rmbrl_read_record(script, '\n', line, sizeof(line));
+        if (len == -1)
+            break;
+
+        char *argv[RMBRL_SCRIPT_MAX_ARGS + 1];
+        argv[0] = "rmbrl";
+        int argc = len < (long)sizeof(line)
+                       ? rmbrl_script_split(line, argv, RMBRL_SCRIPT_MAX_ARGS)
+                       : -1;
+        if (argc > 1 && strcmp(argv[1], "rmbrl") == 0)
+        {
+            memmove(argv + 1, argv + 2, (size_t)(argc - 2) * sizeof(*argv));
+            --argc;
+        }
+        if (argc == -1)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR,
+                      "Line %zu is too long or has an unterminated quote, rolling back\n",
+                      line_number);
+            result = 1;
+            break;
+        }
+        if (argc == 1)
+            continue;
+        argv[argc] = NULL;
+
+        rmbrl_script.line = line_number;
+        if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "Line %zu: %s\n", line_number, argv[1]);
+
+        // the commands of the script have no stdin, it holds the script itself or belongs to it
+        result = rmbrl_run(argc, argv, db, NULL);
+        if (result != 0)
+            rmbrl_log(RMBRL_LOG_ERROR, "Line %zu failed, rolling back the script\n", line_number);
         else
-            raw_stmt = "DELETE FROM memories RETURNING *;";
+            ++commands;
     }
-    else
+    rmbrl_stats = stats;
+
+    if (result == 0 && ferror(script))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to read script: %s\n", strerror(errno));
+        result = 1;
+    }
+    if (script != cmd->input)
+        fclose(script);
+
+    if (!rmbrl_script.active)
+        return 1;
+    rmbrl_script.active = false;
+
+    if (result != 0 || cmd->dry_run)
     {
-        raw_stmt = "DELETE FROM memories WHERE id = ? RETURNING *;";
+        if (rmbrl_db_rollback_transaction(db, cmd->verbosity) != 0)
+            result = 1;
     }
+    else if (rmbrl_db_commit_transaction(db, cmd->verbosity) != 0)
+    {
+        result = 1;
+    }
+
+    if (result == 0 && cmd->verbosity == RMBRL_VERB_VERBOSE)
+        rmbrl_log(RMBRL_LOG_INFO, "%zu commands were run\n", commands);
+
+    return result;
+}
+
+// Commands that never write to the store, they open it read-only and do not create it.
+bool rmbrl_command_is_read_only(Rmbrl_Command_Function function)
+{
+    return function == RMBRL_CMD_PEEK || function == RMBRL_CMD_SEARCH ||
+           function == RMBRL_CMD_PROJECTS || function == RMBRL_CMD_EXPORT ||
+           function == RMBRL_CMD_COMPLETE || function == RMBRL_CMD_STATS ||
+           function == RMBRL_CMD_DUE;
+}
 
-    if (sqlite3_prepare_v2(db, raw_stmt, -1, &stmt, NULL) != SQLITE_OK)
+// A read command on a store that does not exist yet prints what it prints for an empty store,
+// without creating the store or its directory, e.g. for a prompt on a fresh machine.
+int rmbrl_command_run_empty(Rmbrl_Command *cmd)
+{
+    const char *header = NULL;
+    Rmbrl_Format format = cmd->format;
+    switch (cmd->function)
     {
-        rmbrl_log(RMBRL_LOG_ERROR, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+    case RMBRL_CMD_PEEK:
+        header = "Currently Remembering:\n";
+        break;
+    case RMBRL_CMD_SEARCH:
+        header = "Found Memories:\n";
+        break;
+    case RMBRL_CMD_DUE:
+        header = "Due Memories:\n";
+        break;
+    case RMBRL_CMD_PROJECTS:
+        header = "Projects:\n";
+        break;
+    case RMBRL_CMD_EXPORT:
+        if (format == RMBRL_FORMAT_TEXT)
+            format = RMBRL_FORMAT_NDJSON;
+        break;
+    case RMBRL_CMD_COMPLETE:
+        return 0;
+    case RMBRL_CMD_STATS:
+        return rmbrl_command_stats(cmd, NULL);
+    default:
+        RMBRL_UNREACHABLE("empty command function");
+    }
+
+    if (header != NULL && cmd->verbosity != RMBRL_VERB_SILENT && format == RMBRL_FORMAT_TEXT)
+        rmbrl_log(RMBRL_LOG_INFO, "%s", header);
+
+    static Rmbrl_Out out;
+    rmbrl_out_begin(&out, format, cmd->verbosity);
+    rmbrl_out_end(&out);
+    return 0;
+}
+
+int rmbrl_command_run(Rmbrl_Command *cmd, sqlite3 *db)
+{
+    switch (cmd->function)
+    {
+    case RMBRL_CMD_ADD:
+        return rmbrl_command_add(cmd, db);
+    case RMBRL_CMD_PEEK:
+        return cmd->watch ? rmbrl_command_peek_watch(cmd, db) : rmbrl_command_peek(cmd, db);
+    case RMBRL_CMD_CLEAR:
+        return rmbrl_command_clear(cmd, db);
+    case RMBRL_CMD_SEARCH:
+        return rmbrl_command_search(cmd, db);
+    case RMBRL_CMD_PROJECTS:
+        return rmbrl_command_projects(cmd, db);
+    case RMBRL_CMD_GC:
+        return rmbrl_command_gc(cmd, db);
+    case RMBRL_CMD_EXPORT:
+        return rmbrl_command_export(cmd, db);
+    case RMBRL_CMD_IMPORT:
+        return rmbrl_command_import(cmd, db);
+    case RMBRL_CMD_COMPLETE:
+        return rmbrl_command_complete(cmd, db);
+    case RMBRL_CMD_COMPACT:
+        return rmbrl_command_compact(cmd, db);
+    case RMBRL_CMD_STATS:
+        return rmbrl_command_stats(cmd, db);
+    case RMBRL_CMD_DUE:
+        return rmbrl_command_due(cmd, db);
+    case RMBRL_CMD_EXEC:
+        return rmbrl_command_exec(cmd, db);
+    case RMBRL_CMD_BACKUP:
+        return rmbrl_command_backup(cmd, db);
+    case RMBRL_CMD_RESTORE:
+        return rmbrl_command_restore(cmd, db);
+    default:
+        RMBRL_UNREACHABLE("Command function type");
+    }
+}
+
+// Server
+//
+// `rmbrl serve` keeps one connection to the store and its statement cache open and listens on a
+// Unix socket next to the database ("rmbrl.db-sock"). Every other invocation first tries to
+// connect to it and, if that works, sends its arguments along with its stdin, stdout and stderr.
+// The server runs the invocation on its connection with those as its own standard streams and
+// replies with the exit code, so output, --stdin and exit codes are the same as in direct mode
+// while skipping process startup of SQLite, opening the store and preparing statements.
+// Without a server the connect fails immediately and the invocation runs directly.
+//
+// Requests are handled one at a time, writes from several clients are serialized by the server
+// like they are by the write lock otherwise. Invocations running directly still work alongside.
+// A client with --timeout-ms only waits for the reply until its budget runs out, the server runs
+// the request within the same deadline and drops it if the deadline passed while it waited. The
+// environment variables setting defaults are sent along with the arguments, so the client's apply.
+
+#define RMBRL_SERVE_MAGIC 0x524d4253u // "RMBS"
+#define RMBRL_SERVE_PROTOCOL 2
+#define RMBRL_SERVE_MAX_REQUEST (64 * 1024)
+#define RMBRL_SERVE_REJECTED (-1) // reply to requests of another protocol, the client runs directly
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int protocol;
+    unsigned int argc;
+    unsigned int envc;
+    unsigned int size;         // bytes of the NUL terminated arguments and variables following it
+    sqlite3_int64 deadline_ns; // the client's budget, 0 without one
+} Rmbrl_Serve_Header;
+
+int rmbrl_serve_socket_path(const char *db_path, char *socket_path, size_t socket_path_size)
+{
+    if (snprintf(socket_path, socket_path_size, "%s-sock", db_path) >= (int)socket_path_size)
         return 1;
+    return 0;
+}
+
+#ifndef _WIN32
+
+#define RMBRL_SOCKET_PATH_SIZE sizeof(((struct sockaddr_un *)0)->sun_path)
+
+// the environment variables rmbrl_run_invocation reads its defaults from
+static const char *rmbrl_serve_env[] = {"RMBRL_BUSY_TIMEOUT", "RMBRL_TIMEOUT_MS", "RMBRL_BACKEND"};
+
+static volatile sig_atomic_t rmbrl_serve_stop;
+
+void rmbrl_serve_on_signal(int signal)
+{
+    (void)signal;
+    rmbrl_serve_stop = 1;
+}
+
+bool rmbrl_write_all(int fd, const void *data, size_t size)
+{
+    const char *c = data;
+    while (size > 0)
+    {
+        ssize_t written = write(fd, c, size);
+        if (written == -1 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        c += written;
+        size -= (size_t)written;
     }
+    return true;
+}
 
-    if (id != -1)
-        sqlite3_bind_int(stmt, 1, id);
-    else if (cmd->project)
-        sqlite3_bind_text(stmt, 1, cmd->project, -1, SQLITE_STATIC);
+bool rmbrl_read_all(int fd, void *data, size_t size)
+{
+    char *c = data;
+    while (size > 0)
+    {
+        ssize_t got = read(fd, c, size);
+        if (got == -1 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        c += got;
+        size -= (size_t)got;
+    }
+    return true;
+}
 
-    if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+int rmbrl_socket_connect(const char *socket_path)
+{
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
     {
-        char *stmt_str = sqlite3_expanded_sql(stmt);
-        rmbrl_log(RMBRL_LOG_INFO, "Query: %s\n", stmt_str);
+        close(fd);
+        return -1;
     }
+    return fd;
+}
 
-    if (cmd->verbosity != RMBRL_VERB_SILENT)
-        rmbrl_log(RMBRL_LOG_INFO, "Forgotten Memories:\n");
+// Reads one request from client and runs it with the client's standard streams.
+void rmbrl_serve_request(int client, sqlite3 *db)
+{
+    Rmbrl_Serve_Header header;
+    int fds[3];
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = {.iov_base = &header, .iov_len = sizeof(header)};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t got = recvmsg(client, &msg, 0);
+    if (got <= 0)
+        return;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+        return;
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    int code = RMBRL_SERVE_REJECTED;
+    char *args = NULL;
+    char **argv = NULL;
+    size_t env_count = sizeof(rmbrl_serve_env) / sizeof(rmbrl_serve_env[0]);
+    if (got != (ssize_t)sizeof(header) || header.magic != RMBRL_SERVE_MAGIC ||
+        header.protocol != RMBRL_SERVE_PROTOCOL || header.argc == 0 ||
+        header.envc > env_count || header.size > RMBRL_SERVE_MAX_REQUEST)
+        goto reply;
+
+    args = RMBRL_REALLOC(NULL, header.size + 1);
+    argv = RMBRL_REALLOC(NULL, (header.argc + header.envc + 1) * sizeof(*argv));
+    RMBRL_ASSERT(args != NULL && argv != NULL && "Buy more RAM lol");
+    if (!rmbrl_read_all(client, args, header.size))
+        goto reply;
+    args[header.size] = '\0';
+
+    // arguments and then "NAME=value" of the variables are NUL terminated one after another
+    size_t offset = 0;
+    for (unsigned int i = 0; i < header.argc + header.envc; ++i)
+    {
+        if (offset >= header.size)
+            goto reply;
+        argv[i] = args + offset;
+        offset += strlen(argv[i]) + 1;
+    }
+    char **env = argv + header.argc + 1;
+    memmove(env, argv + header.argc, header.envc * sizeof(*argv));
+    argv[header.argc] = NULL;
+
+    // the client gave up on the reply already
+    if (header.deadline_ns != 0 && header.deadline_ns <= rmbrl_stats_now_ns())
+    {
+        code = RMBRL_EXIT_TIMEOUT;
+        goto reply;
+    }
+
+    for (size_t i = 0; i < env_count; ++i)
+        unsetenv(rmbrl_serve_env[i]);
+    for (unsigned int i = 0; i < header.envc; ++i)
+    {
+        char *value = strchr(env[i], '=');
+        if (value == NULL)
+            continue;
+        *value++ = '\0';
+        for (size_t j = 0; j < env_count; ++j)
+            if (strcmp(env[i], rmbrl_serve_env[j]) == 0)
+                setenv(env[i], value, 1);
+    }
+
+    FILE *input = fdopen(fds[0], "r");
+    if (input == NULL)
+        goto reply;
+    fds[0] = -1;
+
+    fflush(stdout);
+    fflush(stderr);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int saved_stderr = dup(STDERR_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[2], STDERR_FILENO);
+
+    rmbrl_budget_client_deadline_ns = header.deadline_ns;
+    code = rmbrl_run((int)header.argc, argv, db, input);
+    rmbrl_budget_client_deadline_ns = 0;
+
+    // a request that failed halfway may have left its transaction open
+    if (!sqlite3_get_autocommit(db))
+        sqlite3_exec(db, "ROLLBACK;", NULL, 0, NULL);
+
+    fflush(stdout);
+    fflush(stderr);
+    clearerr(stdout);
+    clearerr(stderr);
+    dup2(saved_stdout, STDOUT_FILENO);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stdout);
+    close(saved_stderr);
+    fclose(input);
+
+reply:
+    rmbrl_write_all(client, &code, sizeof(code));
+    for (size_t i = 0; i < 3; ++i)
+        if (fds[i] != -1)
+            close(fds[i]);
+    RMBRL_FREE(argv);
+    RMBRL_FREE(args);
+
+    // whatever the invocation allocated, including what its error paths did not free
+    rmbrl_arena_reset();
+}
+
+#endif // end _WIN32
+
+int rmbrl_command_serve(Rmbrl_Command *cmd, const char *db_path)
+{
+#ifdef _WIN32
+    (void)cmd;
+    (void)db_path;
+    rmbrl_log(RMBRL_LOG_ERROR, "\"serve\" is not supported on Windows yet\n");
+    return 1;
+#else
+    char socket_path[RMBRL_SOCKET_PATH_SIZE];
+    if (rmbrl_serve_socket_path(db_path, socket_path, sizeof(socket_path)) != 0)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Socket path for \"%s\" is too long\n", db_path);
+        return 1;
+    }
+
+    int fd = rmbrl_socket_connect(socket_path);
+    if (fd != -1)
+    {
+        close(fd);
+        rmbrl_log(RMBRL_LOG_ERROR, "Already serving %s\n", db_path);
+        return 1;
+    }
 
+    sqlite3 *db = NULL;
     int result;
-    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    if (rmbrl_db_open(db_path, cmd, &db) != 0)
+        RMBRL_CLEANUP_RETURN(1);
+
+    if (rmbrl_db_migrate(db, cmd->verbosity) != 0)
+        RMBRL_CLEANUP_RETURN(1);
+
+    // a socket left behind by a server that did not shut down cleanly refused the connection above
+    unlink(socket_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    // only the owner of the store may connect, clients hand over their streams and write to it
+    mode_t umask_prev = umask(077);
+    int bound = fd != -1 ? bind(fd, (struct sockaddr *)&addr, sizeof(addr)) : -1;
+    umask(umask_prev);
+    if (bound == -1 || listen(fd, 64) == -1)
     {
-        // int id = sqlite3_column_int(stmt, 0);
+        rmbrl_log(RMBRL_LOG_ERROR, "Failed to listen on %s: %s\n", socket_path, strerror(errno));
+        if (fd != -1)
+            close(fd);
+        RMBRL_CLEANUP_RETURN(1);
+    }
 
-        const unsigned char *task = sqlite3_column_text(stmt, 1);
-        rmbrl_log(RMBRL_LOG_INFO, "    \"%s\"", task);
+    // no SA_RESTART, so the signal interrupts accept and the loop below gets to clean up
+    struct sigaction action = {0};
+    action.sa_handler = rmbrl_serve_on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    // a client going away while its output is written must not take down the server
+    signal(SIGPIPE, SIG_IGN);
 
-        const char *project = (char *)sqlite3_column_text(stmt, 2);
-        if (strlen(project) > 0)
-            fprintf(stderr, " -- %s", project);
+    if (cmd->verbosity != RMBRL_VERB_SILENT)
+        rmbrl_log(RMBRL_LOG_INFO, "Serving %s on %s\n", db_path, socket_path);
 
-        if (cmd->verbosity == RMBRL_VERB_VERBOSE)
+    while (!rmbrl_serve_stop)
+    {
+        int client = accept(fd, NULL, NULL);
+        if (client == -1)
         {
-            char *created_at = rmbrl_strdup((char *)sqlite3_column_text(stmt, 3));
-            created_at[10] = '\0';
-            fprintf(stderr, " -- %s", created_at);
-            RMBRL_FREE(created_at);
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            rmbrl_log(RMBRL_LOG_ERROR, "Failed to accept connection: %s\n", strerror(errno));
+            break;
         }
+        rmbrl_serve_request(client, db);
+        close(client);
+    }
+
+    close(fd);
+    unlink(socket_path);
+    if (cmd->verbosity != RMBRL_VERB_SILENT)
+        rmbrl_log(RMBRL_LOG_INFO, "Stopped serving %s\n", db_path);
+    result = 0;
+
+cleanup:
+    rmbrl_db_close(db);
+    return result;
+#endif // end _WIN32
+}
+
+// Forwards the invocation to `rmbrl serve` for db_path.
+// Returns its exit code, or -1 if no server is running and the invocation has to run directly.
+int rmbrl_client_forward(const char *db_path, int argc, char **argv)
+{
+#ifdef _WIN32
+    (void)db_path;
+    (void)argc;
+    (void)argv;
+    return -1;
+#else
+    char socket_path[RMBRL_SOCKET_PATH_SIZE];
+    if (rmbrl_serve_socket_path(db_path, socket_path, sizeof(socket_path)) != 0)
+        return -1;
+
+    int fd = rmbrl_socket_connect(socket_path);
+    if (fd == -1)
+        return -1;
+
+    Rmbrl_Serve_Header header = {
+        .magic = RMBRL_SERVE_MAGIC,
+        .protocol = RMBRL_SERVE_PROTOCOL,
+        .argc = (unsigned int)argc,
+        .deadline_ns = rmbrl_budget.deadline_ns,
+    };
+    for (int i = 0; i < argc; ++i)
+        header.size += (unsigned int)strlen(argv[i]) + 1;
+
+    Rmbrl_String_Builder env = {0};
+    for (size_t i = 0; i < sizeof(rmbrl_serve_env) / sizeof(rmbrl_serve_env[0]); ++i)
+    {
+        const char *value = getenv(rmbrl_serve_env[i]);
+        if (value == NULL)
+            continue;
+        rmbrl_sb_append_cstr(&env, rmbrl_serve_env[i]);
+        rmbrl_sb_append_cstr(&env, "=");
+        rmbrl_sb_append_cstr(&env, value);
+        rmbrl_sb_append_null(&env);
+        header.envc++;
+    }
+    header.size += (unsigned int)env.count;
+    if (header.size > RMBRL_SERVE_MAX_REQUEST)
+    {
+        rmbrl_sb_free(env);
+        close(fd);
+        return -1;
+    }
+
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))] = {0};
+    struct iovec iov = {.iov_base = &header, .iov_len = sizeof(header)};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
 
-        fprintf(stderr, "\n");
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    bool sent = sendmsg(fd, &msg, 0) == (ssize_t)sizeof(header);
+    for (int i = 0; sent && i < argc; ++i)
+        sent = rmbrl_write_all(fd, argv[i], strlen(argv[i]) + 1);
+    if (sent && env.count > 0)
+        sent = rmbrl_write_all(fd, env.items, env.count);
+    rmbrl_sb_free(env);
+
+    // the server runs one request at a time, waiting for the reply is bounded by the budget
+    struct pollfd reply = {.fd = fd, .events = POLLIN};
+    int ready = 0;
+    while (sent)
+    {
+        ready = poll(&reply, 1, rmbrl_budget.deadline_ns == 0 ? -1 : rmbrl_budget_remaining_ms());
+        if (ready != -1 || errno != EINTR)
+            break;
     }
-    sqlite3_finalize(stmt);
 
-    if (result != SQLITE_DONE)
+    int code;
+    bool replied = sent && ready > 0 && rmbrl_read_all(fd, &code, sizeof(code));
+    close(fd);
+
+    if (!sent)
+        return -1;
+    if (ready == 0)
     {
-        rmbrl_log(RMBRL_LOG_ERROR, "Failed to forget memories: %s\n", sqlite3_errmsg(db));
+        // the caller exits with RMBRL_EXIT_TIMEOUT
+        rmbrl_budget.expired = true;
         return 1;
     }
-
-    if (cmd->dry_run)
+    if (!replied)
     {
-        result = rmbrl_db_rollback_transaction(db, cmd->verbosity);
-        if (result != 0)
-            return result;
+        rmbrl_log(RMBRL_LOG_ERROR, "Lost connection to rmbrl serve\n");
+        return 1;
     }
-
-    return 0;
+    return code == RMBRL_SERVE_REJECTED ? -1 : code;
+#endif // end _WIN32
 }
 
-int main(int argc, char **argv)
+int rmbrl_run_invocation(int argc, char **argv, sqlite3 *served_db, FILE *input)
 {
     if (argc <= 1)
     {
@@ -572,7 +7058,23 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    sqlite3_int64 mark = rmbrl_stats.start_ns;
     Rmbrl_Command cmd = {0};
+    cmd.input = input;
+    cmd.batch_size = RMBRL_DEFAULT_BATCH_SIZE;
+    cmd.busy_timeout_ms = RMBRL_DEFAULT_BUSY_TIMEOUT_MS;
+    cmd.window_ms = RMBRL_DEFAULT_DUE_WINDOW_MS;
+
+    sqlite3_int64 busy_timeout;
+    if (rmbrl_parse_int(getenv("RMBRL_BUSY_TIMEOUT"), &busy_timeout) && busy_timeout >= 0)
+        cmd.busy_timeout_ms = (int)busy_timeout;
+    sqlite3_int64 timeout;
+    if (rmbrl_parse_int(getenv("RMBRL_TIMEOUT_MS"), &timeout) && timeout >= 0 &&
+        timeout <= 24 * 60 * 60 * 1000)
+        cmd.timeout_ms = (int)timeout;
+    const char *backend = getenv("RMBRL_BACKEND");
+    if (backend != NULL && strcmp(backend, "log") == 0)
+        cmd.backend = RMBRL_BACKEND_LOG;
 
     if (strcmp(argv[1], "add") == 0)
         cmd.function = RMBRL_CMD_ADD;
@@ -580,6 +7082,34 @@ int main(int argc, char **argv)
         cmd.function = RMBRL_CMD_PEEK;
     else if (strcmp(argv[1], "clear") == 0)
         cmd.function = RMBRL_CMD_CLEAR;
+    else if (strcmp(argv[1], "search") == 0)
+        cmd.function = RMBRL_CMD_SEARCH;
+    else if (strcmp(argv[1], "projects") == 0)
+        cmd.function = RMBRL_CMD_PROJECTS;
+    else if (strcmp(argv[1], "gc") == 0)
+        cmd.function = RMBRL_CMD_GC;
+    else if (strcmp(argv[1], "export") == 0)
+        cmd.function = RMBRL_CMD_EXPORT;
+    else if (strcmp(argv[1], "import") == 0)
+        cmd.function = RMBRL_CMD_IMPORT;
+    else if (strcmp(argv[1], "complete") == 0)
+        cmd.function = RMBRL_CMD_COMPLETE;
+    else if (strcmp(argv[1], "compact") == 0)
+        cmd.function = RMBRL_CMD_COMPACT;
+    else if (strcmp(argv[1], "stats") == 0)
+        cmd.function = RMBRL_CMD_STATS;
+    else if (strcmp(argv[1], "due") == 0)
+        cmd.function = RMBRL_CMD_DUE;
+    else if (strcmp(argv[1], "exec") == 0)
+        cmd.function = RMBRL_CMD_EXEC;
+    else if (strcmp(argv[1], "backup") == 0)
+        cmd.function = RMBRL_CMD_BACKUP;
+    else if (strcmp(argv[1], "restore") == 0)
+        cmd.function = RMBRL_CMD_RESTORE;
+    else if (strcmp(argv[1], "init") == 0 && (served_db == NULL || rmbrl_script.active))
+        cmd.function = RMBRL_CMD_INIT;
+    else if (strcmp(argv[1], "serve") == 0 && (served_db == NULL || rmbrl_script.active))
+        cmd.function = RMBRL_CMD_SERVE;
 
     if (cmd.function == RMBRL_CMD_UNKNOWN)
     {
@@ -612,35 +7142,307 @@ int main(int argc, char **argv)
             cmd.verbosity = RMBRL_VERB_SILENT;
             continue;
         }
-        // support "-p=name" and "-p name"
-        // support "--project=name" and "--project name"
-        if (strncmp(argv[i], "-p", 2) == 0 || strncmp(argv[i], "--project", 9) == 0)
+        if (strcmp(argv[i], "--stats") == 0)
+        {
+            cmd.stats = true;
+            continue;
+        }
+        char *value = NULL;
+        int match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--backend", &value);
+        if (match == 1)
+        {
+            if (strcmp(value, "sqlite") == 0)
+                cmd.backend = RMBRL_BACKEND_SQLITE;
+            else if (strcmp(value, "log") == 0)
+                cmd.backend = RMBRL_BACKEND_LOG;
+            else
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Unknown backend \"%s\", expected sqlite or log\n",
+                          value);
+                return 1;
+            }
+            continue;
+        }
+        if (match == -1)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Backend flag provided but missing backend\n");
+            return 1;
+        }
+
+        match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--format", &value);
+        if (match == 1)
+        {
+            if (strcmp(value, "text") == 0)
+                cmd.format = RMBRL_FORMAT_TEXT;
+            else if (strcmp(value, "tsv") == 0)
+                cmd.format = RMBRL_FORMAT_TSV;
+            else if (strcmp(value, "json") == 0)
+                cmd.format = RMBRL_FORMAT_JSON;
+            else if (strcmp(value, "ndjson") == 0)
+                cmd.format = RMBRL_FORMAT_NDJSON;
+            else if (strcmp(value, "csv") == 0)
+                cmd.format = RMBRL_FORMAT_CSV;
+            else
+            {
+                rmbrl_log(RMBRL_LOG_ERROR,
+                          "Unknown format \"%s\", expected text, tsv, json, ndjson or csv\n",
+                          value);
+                return 1;
+            }
+            continue;
+        }
+        if (match == -1)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Format flag provided but missing format\n");
+            return 1;
+        }
+
+        match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--db", &value);
+        if (match == 1)
+        {
+            cmd.db_override = value;
+            continue;
+        }
+        if (match == -1)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Database flag provided but missing path\n");
+            return 1;
+        }
+
+        match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--busy-timeout", &value);
+        if (match == 1)
+        {
+            sqlite3_int64 busy_timeout;
+            if (!rmbrl_parse_int(value, &busy_timeout) || busy_timeout < 0 ||
+                busy_timeout > 24 * 60 * 60 * 1000)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR,
+                          "Busy timeout must be a number of milliseconds, got \"%s\"\n", value);
+                return 1;
+            }
+            cmd.busy_timeout_ms = (int)busy_timeout;
+            continue;
+        }
+        if (match == -1)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Busy timeout flag provided but missing value\n");
+            return 1;
+        }
+
+        match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--timeout-ms", &value);
+        if (match == 1)
+        {
+            if (!rmbrl_parse_int(value, &timeout) || timeout < 0 || timeout > 24 * 60 * 60 * 1000)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Timeout must be a number of milliseconds, got \"%s\"\n",
+                          value);
+                return 1;
+            }
+            cmd.timeout_ms = (int)timeout;
+            continue;
+        }
+        if (match == -1)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Timeout flag provided but missing value\n");
+            return 1;
+        }
+
+        match = rmbrl_parse_flag_value(argc, argv, &i, "-p", "--project", &value);
+        if (match == 1)
+        {
+            cmd.project = value;
+            continue;
+        }
+        if (match == -1)
+        {
+            rmbrl_log(RMBRL_LOG_ERROR, "Project flag provided but missing project name\n");
+            return 1;
+        }
+
+        if (cmd.function == RMBRL_CMD_ADD || cmd.function == RMBRL_CMD_PEEK ||
+            cmd.function == RMBRL_CMD_DUE)
+        {
+            match = rmbrl_parse_flag_value(argc, argv, &i, "-t", "--tag", &value);
+            if (match == 1)
+            {
+                if (cmd.tags_count == RMBRL_MAX_TAGS)
+                {
+                    rmbrl_log(RMBRL_LOG_ERROR, "At most %d tags are supported\n", RMBRL_MAX_TAGS);
+                    return 1;
+                }
+                cmd.tags[cmd.tags_count++] = value;
+                continue;
+            }
+            if (match == -1)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Tag flag provided but missing tag name\n");
+                return 1;
+            }
+        }
+
+        if (cmd.function == RMBRL_CMD_ADD)
         {
-            if (argv[i][2] == '=')
+            if (strcmp(argv[i], "--stdin") == 0)
+            {
+                cmd.from_stdin = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--null") == 0 || strcmp(argv[i], "-0") == 0)
             {
-                cmd.project = argv[i] + 3;
+                cmd.null_delimited = true;
                 continue;
             }
-            if (argv[i][9] == '=')
+
+            match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--due", &value);
+            if (match == 1)
             {
-                cmd.project = argv[i] + 10;
+                if (!rmbrl_parse_due(value, &cmd.due_at))
+                {
+                    rmbrl_log(RMBRL_LOG_ERROR,
+                              "Due must be a duration such as 2d, a date such as 2026-10-20 or a "
+                              "UTC time such as \"2026-10-20 17:00:00\", got \"%s\"\n",
+                              value);
+                    return 1;
+                }
                 continue;
             }
+            if (match == -1)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Due flag provided but missing time\n");
+                return 1;
+            }
+        }
 
-            // assume cmd is in format of "--project name"
+        if (cmd.function == RMBRL_CMD_DUE)
+        {
+            match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--window", &value);
+            if (match == 1)
+            {
+                if (!rmbrl_parse_duration(value, &cmd.window_ms))
+                {
+                    rmbrl_log(RMBRL_LOG_ERROR,
+                              "Window must be a duration such as 1d or 12h, got \"%s\"\n", value);
+                    return 1;
+                }
+                continue;
+            }
+            if (match == -1)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Window flag provided but missing duration\n");
+                return 1;
+            }
+        }
 
-            // bounds check and check name was provided
-            // ex:
-            //   correct: rmbrl peek -p name
-            //   wrong  : rmbrl peek -p --all
-            //   wrong  : rmbrl peek -p -v
-            if (++i < argc && argv[i][0] != '-')
+        if (cmd.function == RMBRL_CMD_ADD || cmd.function == RMBRL_CMD_IMPORT)
+        {
+            match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--batch-size", &value);
+            if (match == 1)
             {
-                cmd.project = argv[i];
+                sqlite3_int64 batch_size;
+                if (!rmbrl_parse_int(value, &batch_size) || batch_size < 1)
+                {
+                    rmbrl_log(RMBRL_LOG_ERROR, "Batch size must be a positive number, got \"%s\"\n",
+                              value);
+                    return 1;
+                }
+                cmd.batch_size = (size_t)batch_size;
                 continue;
             }
-            rmbrl_log(RMBRL_LOG_ERROR, "Project flag provided but missing project name\n");
-            return 1;
+            if (match == -1)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Batch size flag provided but missing value\n");
+                return 1;
+            }
+        }
+
+        if (cmd.function == RMBRL_CMD_PEEK || cmd.function == RMBRL_CMD_SEARCH ||
+            cmd.function == RMBRL_CMD_CLEAR || cmd.function == RMBRL_CMD_STATS ||
+            cmd.function == RMBRL_CMD_DUE)
+        {
+            match = rmbrl_parse_flag_value(argc, argv, &i, "-l", "--limit", &value);
+            if (match == 1)
+            {
+                if (!rmbrl_parse_int(value, &cmd.limit) || cmd.limit < 1)
+                {
+                    rmbrl_log(RMBRL_LOG_ERROR, "Limit must be a positive number, got \"%s\"\n",
+                              value);
+                    return 1;
+                }
+                cmd.has_limit = true;
+                continue;
+            }
+            if (match == -1)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Limit flag provided but missing value\n");
+                return 1;
+            }
+        }
+
+        if (cmd.function == RMBRL_CMD_CLEAR && strcmp(argv[i], "--archive") == 0)
+        {
+            cmd.archive = true;
+            continue;
+        }
+
+        if (cmd.function == RMBRL_CMD_CLEAR || cmd.function == RMBRL_CMD_GC)
+        {
+            match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--older-than", &value);
+            if (match == 1)
+            {
+                if (!rmbrl_parse_duration(value, &cmd.older_than_ms) || cmd.older_than_ms < 1)
+                {
+                    rmbrl_log(RMBRL_LOG_ERROR,
+                              "Older than must be a duration such as 30d or 12h, got \"%s\"\n",
+                              value);
+                    return 1;
+                }
+                continue;
+            }
+            if (match == -1)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "Older than flag provided but missing duration\n");
+                return 1;
+            }
+        }
+
+        if (cmd.function == RMBRL_CMD_PEEK)
+        {
+            if (strcmp(argv[i], "--cached") == 0)
+            {
+                cmd.cached = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--global") == 0)
+            {
+                cmd.global = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--by-due") == 0)
+            {
+                cmd.by_due = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--watch") == 0)
+            {
+                cmd.watch = true;
+                continue;
+            }
+
+            match = rmbrl_parse_flag_value(argc, argv, &i, NULL, "--after", &value);
+            if (match == 1)
+            {
+                if (!rmbrl_parse_int(value, &cmd.after_id) || cmd.after_id < 1)
+                {
+                    rmbrl_log(RMBRL_LOG_ERROR, "After must be a memory id, got \"%s\"\n", value);
+                    return 1;
+                }
+                continue;
+            }
+            if (match == -1)
+            {
+                rmbrl_log(RMBRL_LOG_ERROR, "After flag provided but missing memory id\n");
+                return 1;
+            }
         }
 
         // since no match above, assume first unknown arg not prefixed with '-' is the task
@@ -661,11 +7463,48 @@ int main(int argc, char **argv)
             cmd.task = argv[i];
             continue;
         }
+        if (cmd.function == RMBRL_CMD_SEARCH && cmd.query == NULL && argv[i][0] != '-')
+        {
+            cmd.query = argv[i];
+            continue;
+        }
+        if (cmd.function == RMBRL_CMD_COMPLETE && argv[i][0] != '-')
+        {
+            if (cmd.complete == NULL)
+            {
+                cmd.complete = argv[i];
+                continue;
+            }
+            if (cmd.prefix == NULL)
+            {
+                cmd.prefix = argv[i];
+                continue;
+            }
+        }
+        if (cmd.function == RMBRL_CMD_EXEC && cmd.script == NULL &&
+            (argv[i][0] != '-' || strcmp(argv[i], "-") == 0))
+        {
+            cmd.script = argv[i];
+            continue;
+        }
+        if ((cmd.function == RMBRL_CMD_BACKUP || cmd.function == RMBRL_CMD_RESTORE) &&
+            cmd.path == NULL && argv[i][0] != '-')
+        {
+            cmd.path = argv[i];
+            continue;
+        }
+        if (cmd.function == RMBRL_CMD_BACKUP && strcmp(argv[i], "--compact") == 0)
+        {
+            cmd.compact = true;
+            continue;
+        }
 
         rmbrl_da_append(&ignored_flags, argv[i]);
     }
 
-    if (cmd.verbosity != RMBRL_VERB_SILENT && ignored_flags.count > 0)
+    // a forwarded invocation was already checked by the client, which printed these
+    bool checked = served_db != NULL && !rmbrl_script.active;
+    if (!checked && cmd.verbosity != RMBRL_VERB_SILENT && ignored_flags.count > 0)
     {
         rmbrl_log(RMBRL_LOG_WARNING, "Ignoring flags: ");
         for (size_t i = 0; i < ignored_flags.count; ++i)
@@ -678,107 +7517,234 @@ int main(int argc, char **argv)
     }
     rmbrl_da_free(ignored_flags);
 
-    if (cmd.verbosity == RMBRL_VERB_VERBOSE)
+    rmbrl_stats.enabled = cmd.stats;
+    rmbrl_stats.command = rmbrl_command_function_str(cmd.function);
+
+    if (!checked && cmd.verbosity == RMBRL_VERB_VERBOSE)
         rmbrl_command_debug_print(&cmd);
 
-    if (cmd.function == RMBRL_CMD_ADD && cmd.task == NULL)
+    if (cmd.function == RMBRL_CMD_EXEC && cmd.script == NULL)
+        cmd.script = "-";
+
+    if (input == NULL && (cmd.from_stdin || cmd.function == RMBRL_CMD_IMPORT))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Commands of a script cannot read stdin\n");
+        return 1;
+    }
+
+    // gc commits between batches and VACUUM cannot run inside of a transaction, init and
+    // --global work on other stores than the one of the script, --watch never ends and backup and
+    // restore copy committed pages
+    if (rmbrl_script.active && (cmd.function == RMBRL_CMD_GC || cmd.function == RMBRL_CMD_EXEC ||
+                                cmd.function == RMBRL_CMD_INIT ||
+                                cmd.function == RMBRL_CMD_SERVE || cmd.global || cmd.watch ||
+                                cmd.function == RMBRL_CMD_BACKUP ||
+                                cmd.function == RMBRL_CMD_RESTORE))
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Running \"%s\" inside of a script is not supported\n",
+                  argv[1]);
+        return 1;
+    }
+
+    if (cmd.function == RMBRL_CMD_ADD && cmd.from_stdin && cmd.task != NULL)
+    {
+        rmbrl_log(RMBRL_LOG_ERROR, "Running \"add --stdin\" but a task description was provided\n");
+        return 1;
+    }
+
+    if (cmd.function == RMBRL_CMD_ADD && !cmd.from_stdin && cmd.task == NULL)
     {
         rmbrl_log(RMBRL_LOG_ERROR, "Running \"add\" command but missing task description\n");
         return 1;
     }
 
-    char db_path[512];
-#ifdef _WIN32
-    char *appdata = getenv("APPDATA");
-    if (appdata == NULL)
+    if (cmd.global && (cmd.by_due || cmd.tags_count > 0 || cmd.watch))
     {
-        rmbrl_log(RMBRL_LOG_ERROR, "APPDATA environment variable not found!\n");
+        rmbrl_log(RMBRL_LOG_ERROR,
+                  "Running \"peek --global\" does not support --by-due, --tag or --watch\n");
         return 1;
     }
-    snprintf(db_path, sizeof(db_path), "%s\\rmbrl\\", appdata);
-    int result = mkdir(db_path);
-#elif defined(__APPLE__) && defined(__MACH__)
 
-    char *home_env = getenv("HOME");
-    if (home_env == NULL)
+    if ((cmd.function == RMBRL_CMD_BACKUP || cmd.function == RMBRL_CMD_RESTORE) &&
+        cmd.path == NULL)
     {
-        rmbrl_log(RMBRL_LOG_ERROR, "HOME environment variable not found!\n");
+        rmbrl_log(RMBRL_LOG_ERROR, "Running \"%s\" command but missing path of the backup\n",
+                  argv[1]);
         return 1;
     }
-    snprintf(db_path, sizeof(db_path), "%s/Library/Application Support/rmbrl/", home_env);
-    int result = mkdir(db_path, 0755);
-#elif defined(__linux__)
-    char *home_env = getenv("HOME");
-    if (home_env == NULL)
+
+    if (cmd.function == RMBRL_CMD_SEARCH && cmd.query == NULL)
     {
-        rmbrl_log(RMBRL_LOG_ERROR, "HOME environment variable not found!\n");
+        rmbrl_log(RMBRL_LOG_ERROR, "Running \"search\" command but missing query\n");
         return 1;
     }
-    snprintf(db_path, sizeof(db_path), "%s/.local/share/rmbrl/", home_env);
-    int result = mkdir(db_path, 0755);
-#else
-    rmbrl_log(RMBRL_LOG_ERROR, "Running on an unknown operating system.\n");
-    return 1;
-#endif
 
-    // NOTE: db_path will already exist if user provided --install flag when building remembrall
-    if (result == -1 && errno != EEXIST)
+    const char *completion_script = NULL;
+    if (cmd.function == RMBRL_CMD_COMPLETE &&
+        (cmd.complete == NULL ||
+         (strcmp(cmd.complete, "projects") != 0 &&
+          (completion_script = rmbrl_completion_script(cmd.complete)) == NULL)))
     {
-        rmbrl_log(RMBRL_LOG_ERROR, "Failed to create path: %s\nReason: %s\n", db_path,
-                  strerror(errno));
+        rmbrl_log(RMBRL_LOG_ERROR, "Running \"complete\" expects projects, bash, zsh or fish\n");
         return 1;
     }
-    strncat(db_path, "rmbrl.db", 9);
+
+    // the completion scripts are part of the binary, printing one does not need a store
+    if (completion_script != NULL)
+    {
+        fputs(completion_script, stdout);
+        return 0;
+    }
+
+    rmbrl_stats_phase(&rmbrl_stats.parse_ns, &mark);
+    if (!rmbrl_script.active)
+        rmbrl_budget_begin(cmd.timeout_ms);
+
+    if (served_db != NULL)
+    {
+        rmbrl_busy.timeout_ms = cmd.busy_timeout_ms;
+        rmbrl_db_set_budget(served_db);
+        size_t folded;
+        if (!rmbrl_script.active && cmd.function != RMBRL_CMD_PEEK &&
+            cmd.function != RMBRL_CMD_COMPACT && rmbrl_wlog_fold(served_db, cmd.verbosity, &folded))
+            return 1;
+        int code = rmbrl_command_run(&cmd, served_db);
+        rmbrl_stats_phase(&rmbrl_stats.run_ns, &mark);
+        rmbrl_stats_connection(served_db);
+        return code;
+    }
+
+    // both work on more than the one store this invocation would open
+    if (cmd.function == RMBRL_CMD_INIT || cmd.global)
+    {
+        int code = cmd.global ? rmbrl_command_peek_global(&cmd) : rmbrl_command_init(&cmd);
+        rmbrl_stats_phase(&rmbrl_stats.run_ns, &mark);
+        return code;
+    }
+
+    // a dry run of add or clear only reads the store, it never waits for the write lock
+    char db_path[512];
+    bool writes = !rmbrl_command_is_read_only(cmd.function);
+    bool read_only = !writes || (cmd.dry_run && (cmd.function == RMBRL_CMD_ADD ||
+                                                  cmd.function == RMBRL_CMD_CLEAR));
+    if (rmbrl_db_path(db_path, sizeof(db_path), cmd.db_override, writes || cmd.watch) != 0)
+        return 1;
+    rmbrl_stats_phase(&rmbrl_stats.path_ns, &mark);
 
     if (cmd.verbosity == RMBRL_VERB_VERBOSE)
         rmbrl_log(RMBRL_LOG_INFO, "DB Path: %s\n", db_path);
 
-    sqlite3 *db;
-    result = sqlite3_open(db_path, &db);
-    if (result != SQLITE_OK)
+    // every request reports its own stats, the server has nothing left to report once it stops
+    if (cmd.function == RMBRL_CMD_SERVE)
     {
-        rmbrl_log(RMBRL_LOG_ERROR, "Databased connection failed: %s\n", sqlite3_errmsg(db));
-        return 1;
+        int code = rmbrl_command_serve(&cmd, db_path);
+        rmbrl_stats.enabled = false;
+        return code;
     }
 
-    if (cmd.verbosity == RMBRL_VERB_VERBOSE)
-        rmbrl_log(RMBRL_LOG_INFO, "Database connection successful!\n");
+    if (cmd.function == RMBRL_CMD_PEEK && rmbrl_command_peek_cached(&cmd, db_path) == 0)
+    {
+        rmbrl_stats_phase(&rmbrl_stats.run_ns, &mark);
+        return 0;
+    }
 
-    char *err_msg;
-    char *statement = "CREATE TABLE IF NOT EXISTS memories("
-                      "id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,"
-                      "task TEXT NOT NULL,"
-                      "project TEXT DEFAULT '' NOT NULL,"
-                      "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP NOT NULL);";
+    // appending to the write log does not open the store at all, see "Write log". Its records have
+    // no due date or tags, memories with them are committed directly.
+    size_t wlog_size;
+    if (cmd.function == RMBRL_CMD_ADD && cmd.backend == RMBRL_BACKEND_LOG && !cmd.from_stdin &&
+        !cmd.dry_run && cmd.due_at == 0 && cmd.tags_count == 0)
+    {
+        int code = rmbrl_wlog_append(&cmd, db_path, &wlog_size);
+        if (code == 0)
+            rmbrl_log(RMBRL_LOG_INFO, "\"%s\" was added to your memory!\n", cmd.task);
+        if (code == 0 && wlog_size >= RMBRL_WLOG_FOLD_BYTES)
+            rmbrl_wlog_fold_store(db_path, &cmd);
+        if (code != -1)
+        {
+            rmbrl_stats_phase(&rmbrl_stats.run_ns, &mark);
+            return code;
+        }
+    }
 
-    result = sqlite3_exec(db, statement, NULL, 0, &err_msg);
-    if (result != SQLITE_OK)
+    // pending memories of the write log are folded by the read-write path, only peek and the
+    // preview of add merge them
+    if (read_only && cmd.function != RMBRL_CMD_PEEK && cmd.function != RMBRL_CMD_ADD &&
+        rmbrl_wlog_pending(db_path))
+        read_only = false;
+
+    // --watch creates the store instead, to wait for its first memory
+    struct stat db_stat;
+    if (read_only && !writes && !cmd.watch && stat(db_path, &db_stat) != 0 && errno == ENOENT &&
+        !rmbrl_wlog_pending(db_path))
     {
-        rmbrl_log(RMBRL_LOG_ERROR, "SQL error: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        RMBRL_CLEANUP_RETURN(1);
+        if (cmd.verbosity == RMBRL_VERB_VERBOSE)
+            rmbrl_log(RMBRL_LOG_INFO, "No database at %s yet\n", db_path);
+        int code = rmbrl_command_run_empty(&cmd);
+        rmbrl_stats_phase(&rmbrl_stats.run_ns, &mark);
+        return code;
     }
 
-    if (cmd.verbosity == RMBRL_VERB_VERBOSE)
-        rmbrl_log(RMBRL_LOG_INFO, "Table \"memories\" exists or created successfully!\n");
+    // the server reports the stats of the invocations it runs, and runs one at a time. The paths
+    // of a backup and of a script file are relative to the directory of the client, a script on
+    // stdin is forwarded.
+    bool forward = !cmd.watch && cmd.function != RMBRL_CMD_BACKUP &&
+                   cmd.function != RMBRL_CMD_RESTORE &&
+                   (cmd.function != RMBRL_CMD_EXEC || strcmp(cmd.script, "-") == 0);
+    int forwarded = forward ? rmbrl_client_forward(db_path, argc, argv) : -1;
+    if (forwarded != -1)
+    {
+        rmbrl_stats.enabled = false;
+        return forwarded;
+    }
 
-    switch (cmd.function)
+    sqlite3 *db = NULL;
+    int result;
+    if (read_only && rmbrl_db_open_read_only(db_path, &cmd, &db) == 0)
     {
-    case RMBRL_CMD_ADD:
-        result = rmbrl_command_add(&cmd, db);
-        break;
-    case RMBRL_CMD_PEEK:
-        result = rmbrl_command_peek(&cmd, db);
-        break;
-    case RMBRL_CMD_CLEAR:
-        result = rmbrl_command_clear(&cmd, db);
-        break;
-    default:
-        RMBRL_UNREACHABLE("Command function type");
-        break;
+        rmbrl_stats_phase(&rmbrl_stats.open_ns, &mark);
+        result = rmbrl_command_run(&cmd, db);
+        rmbrl_stats_phase(&rmbrl_stats.run_ns, &mark);
+        goto cleanup;
     }
 
+    if (rmbrl_db_open(db_path, &cmd, &db) != 0)
+        RMBRL_CLEANUP_RETURN(1);
+    rmbrl_stats_phase(&rmbrl_stats.open_ns, &mark);
+
+    if (rmbrl_db_migrate(db, cmd.verbosity) != 0)
+        RMBRL_CLEANUP_RETURN(1);
+    rmbrl_stats_phase(&rmbrl_stats.schema_ns, &mark);
+
+    size_t folded;
+    if (cmd.function != RMBRL_CMD_COMPACT && rmbrl_wlog_fold(db, cmd.verbosity, &folded) != 0)
+        RMBRL_CLEANUP_RETURN(1);
+
+    result = rmbrl_command_run(&cmd, db);
+    rmbrl_stats_phase(&rmbrl_stats.run_ns, &mark);
+
 cleanup:
-    sqlite3_close(db);
+    rmbrl_stats_connection(db);
+    rmbrl_db_close(db);
     return result;
 }
+
+// Runs one invocation of rmbrl. served_db is the connection of `rmbrl serve` running a forwarded
+// invocation with the client's stdin as input, NULL when running directly.
+int rmbrl_run(int argc, char **argv, sqlite3 *served_db, FILE *input)
+{
+    rmbrl_stats_begin();
+    // the commands of a script share the budget of `rmbrl exec`
+    if (!rmbrl_script.active)
+        rmbrl_budget_begin(0);
+    int code = rmbrl_run_invocation(argc, argv, served_db, input);
+    if (code != 0 && rmbrl_budget.expired)
+        code = RMBRL_EXIT_TIMEOUT;
+    rmbrl_stats_report(code);
+    return code;
+}
+
+int main(int argc, char **argv)
+{
+    rmbrl_sqlite_configure();
+    return rmbrl_run(argc, argv, NULL, stdin);
+}